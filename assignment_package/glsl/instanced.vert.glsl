@@ -15,6 +15,7 @@ in vec4 vs_Pos;             // The array of vertex positions passed to the shade
 in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 in vec2 vs_UV;
 in float vs_Animated;
+in float vs_Tile;
 
 in vec3 vs_ColInstanced;    // The array of vertex colors passed to the shader.
 in vec3 vs_OffsetInstanced; // Used to position each instance of the cube
@@ -25,6 +26,7 @@ out vec4 fs_LightVec;       // The direction in which our virtual light lies, re
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
 out vec2 fs_UV;
 out float fs_Animated;
+flat out float fs_Tile;
 
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
@@ -33,6 +35,7 @@ void main()
 {
     fs_UV = vs_UV;
     fs_Animated = vs_Animated;
+    fs_Tile = vs_Tile;
 
     vec4 offsetPos = vs_Pos + vec4(vs_OffsetInstanced, 0.);
     fs_Pos = offsetPos;
@@ -25,6 +25,7 @@ in vec4 fs_Col;
 
 in vec2 fs_UV;
 in float fs_Animated;
+flat in float fs_Tile;
 
 out vec4 out_Col; // This is the final output color that you will see on your
                   // screen for the pixel that is currently being processed.
@@ -76,7 +77,10 @@ float fbm(vec3 p) {
 
 void main()
 {
-    vec2 uv = fs_UV;
+    // Quads can span several blocks, so wrap the UVs back into
+    // a single block before offsetting them to the block's atlas tile
+    vec2 tile = vec2(mod(fs_Tile, 16.0), floor(fs_Tile / 16.0));
+    vec2 uv = (tile + fract(fs_UV)) / 16.0;
     if (fs_Animated > 0.001f) {
         float secs = floor(u_Time * 0.001);
         secs = mod(secs,16.0f);
@@ -22,17 +22,14 @@ uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformati
 
 uniform vec4 u_Color;       // When drawing the cube instance, we'll set our uniform color to represent different block types.
 
+uniform ivec2 u_ChunkOrigin; // World-space x and z of the minimum corner of the chunk being drawn
+
 //uniform float u_Time;
 //uniform sampler2D u_Texture;
 
-in vec4 vs_Pos;             // The array of vertex positions passed to the shader
-
-in vec4 vs_Nor;             // The array of vertex normals passed to the shader
-
-in vec4 vs_Col;             // The array of vertex colors passed to the shader.
-
-in vec2 vs_UV;
-in float vs_Animated;
+in uvec2 vs_Packed;          // One chunk vertex packed into two words (see ChunkVertex in chunk.h)
+                             // word 0: chunk-space x, y, z, face index and animated flag
+                             // word 1: atlas tile index and UVs measured in blocks
 
 
 out vec4 fs_Pos;
@@ -41,16 +38,30 @@ out vec4 fs_LightVec;       // The direction in which our virtual light lies, re
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
 out vec2 fs_UV;
 out float fs_Animated;
+flat out float fs_Tile;
+
+// The normal of each face, in the same order as neighboring_faces in chunk.cpp
+const vec4 faceNormals[6] = vec4[6](vec4(-1, 0, 0, 0), vec4(1, 0, 0, 0),
+                                    vec4(0, -1, 0, 0), vec4(0, 1, 0, 0),
+                                    vec4(0, 0, -1, 0), vec4(0, 0, 1, 0));
 
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
 
 void main()
 {
+    // Unpack the vertex
+    vec4 vs_Pos = vec4(float(vs_Packed.x & 31u) + float(u_ChunkOrigin.x),
+                       float((vs_Packed.x >> 5) & 511u),
+                       float((vs_Packed.x >> 14) & 31u) + float(u_ChunkOrigin.y),
+                       1);
+    vec4 vs_Nor = faceNormals[(vs_Packed.x >> 19) & 7u];
+
     fs_Pos = vs_Pos;
-    fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader for interpolation
-    fs_UV = vs_UV;
-    fs_Animated = vs_Animated;
+    fs_Col = u_Color;
+    fs_UV = vec2(float((vs_Packed.y >> 8) & 511u), float((vs_Packed.y >> 17) & 511u));
+    fs_Animated = float((vs_Packed.x >> 22) & 1u);
+    fs_Tile = float(vs_Packed.y & 255u);
 
     mat3 invTranspose = mat3(u_ModelInvTr);
     fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
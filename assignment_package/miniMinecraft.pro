@@ -48,6 +48,15 @@ address_sanitizer {
     QMAKE_LFLAGS += -fsanitize=address
 }
 
+# Likewise, CONFIG+=thread_sanitizer builds with ThreadSanitizer to check the
+# terrain worker threads for data races; run with MINIMINECRAFT_BENCHMARK set
+# to put chunk meshing under load without opening the game window.
+thread_sanitizer {
+    message("Enabling Thread Sanitizer")
+    QMAKE_CXXFLAGS += -fsanitize=thread
+    QMAKE_LFLAGS += -fsanitize=thread
+}
+
 HEADERS +=
 
 SOURCES +=
@@ -0,0 +1,1230 @@
+#include "benchmark.h"
+#include "scene/chunk.h"
+#include "scene/terraingen.h"
+#include "scene/generationpipeline.h"
+#include "scene/mpscqueue.h"
+#include "scene/meshbufferpool.h"
+#include "scene/terrain.h"
+#include "scene/terrainview.h"
+#include "smartpointerhelp.h"
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The generator of every world the benchmarks make, unless one says otherwise
+static const TerrainGen defaultGen;
+
+// Searches outward from the origin, one terrain generation zone at a time,
+// for a zone whose center column lies in the given biome
+static glm::ivec2 findZoneWithBiome(BiomeType biome) {
+    for (int r = 0; r < 128; r++) {
+        for (int x = -r; x <= r; x++) {
+            for (int z = -r; z <= r; z++) {
+                if (std::max(std::abs(x), std::abs(z)) != r) continue;
+                glm::ivec2 zone(64 * x, 64 * z);
+                if (std::get<1>(defaultGen.getHeight(glm::vec2(zone + 32))) == biome) {
+                    return zone;
+                }
+            }
+        }
+    }
+    return glm::ivec2(0, 0);
+}
+
+// Generates c's blocks with gen through pipeline on this thread, as a worker does
+static void generateChunk(Chunk &c, const GenerationPipeline &pipeline, const TerrainGen &gen) {
+    GenerationContext ctx(c.getMinPos(), gen, nullptr);
+    pipeline.run(ctx);
+    c.commitGeneration(ctx);
+}
+
+// Generates the 4 x 4 Chunks of the zone with its lower-left corner at the given coords.
+// The Chunks are never drawn, so they do not need an OpenGL context.
+static std::vector<uPtr<Chunk>> generateZone(glm::ivec2 zone, const TerrainGen &gen = defaultGen) {
+    const GenerationPipeline pipeline = GenerationPipeline::defaultPipeline();
+    std::vector<uPtr<Chunk>> chunks;
+    for (int x = zone.x; x < zone.x + 64; x += 16) {
+        for (int z = zone.y; z < zone.y + 64; z += 16) {
+            chunks.push_back(mkU<Chunk>(nullptr, x, z, 0));
+            generateChunk(*chunks.back(), pipeline, gen);
+        }
+    }
+    return chunks;
+}
+
+// Links the neighbor pointers of the Chunks returned by generateZone
+// so that faces between two Chunks of the zone are culled when meshing
+static void linkZone(std::vector<uPtr<Chunk>> &chunks) {
+    for (int x = 0; x < 4; x++) {
+        for (int z = 0; z < 4; z++) {
+            if (x < 3) chunks[4 * x + z]->linkNeighbor(chunks[4 * (x + 1) + z], XPOS);
+            if (z < 3) chunks[4 * x + z]->linkNeighbor(chunks[4 * x + z + 1], ZPOS);
+        }
+    }
+}
+
+static const char* biomeName(BiomeType b) {
+    switch (b) {
+    case GRASSLANDS: return "grasslands";
+    case MOUNTAINS: return "mountains";
+    case VOLCANO: return "volcano";
+    }
+    return "unknown";
+}
+
+static const char* meshingModeName(MeshingMode m) {
+    switch (m) {
+    case NAIVE_MESHING: return "naive:   ";
+    case GREEDY_MESHING: return "greedy:  ";
+    case BITMASK_MESHING: return "bitmask: ";
+    }
+    return "unknown: ";
+}
+
+// Compares the memory held by the palette-compressed block sections of one
+// zone against the flat 65536 byte array every Chunk used to store
+static void benchmarkChunkMemory() {
+    std::cout << "== Block storage per zone ==" << std::endl;
+    const size_t flatBytes = 16 * 65536;
+    for (BiomeType b : {GRASSLANDS, MOUNTAINS, VOLCANO}) {
+        std::vector<uPtr<Chunk>> chunks = generateZone(findZoneWithBiome(b));
+        size_t bytes = 0;
+        for (const uPtr<Chunk> &c : chunks) {
+            bytes += c->blockBytes();
+        }
+        std::cout << biomeName(b) << ": " << bytes << " bytes (flat array: " << flatBytes
+                  << " bytes, " << (100.0 * bytes / flatBytes) << "%)" << std::endl;
+    }
+}
+
+// Moves every Chunk of one zone per biome into the cold tier and back,
+// checking that every block survives, and reports sizes and timings.
+// Returns false if any block differs.
+static bool benchmarkColdTier() {
+    std::cout << "== Cold tier ==" << std::endl;
+    bool ok = true;
+    for (BiomeType b : {GRASSLANDS, MOUNTAINS, VOLCANO}) {
+        std::vector<uPtr<Chunk>> chunks = generateZone(findZoneWithBiome(b));
+        std::vector<std::vector<BlockType>> blocks;
+        size_t hotBytes = 0, coldBytes = 0;
+        for (const uPtr<Chunk> &c : chunks) {
+            blocks.emplace_back();
+            for (unsigned int i = 0; i < 65536; i++) {
+                blocks.back().push_back(c->getBlockAt(i % 16, (i / 16) % 256, i / 4096));
+            }
+            hotBytes += c->blockBytes();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (const uPtr<Chunk> &c : chunks) {
+            unsigned int version;
+            c->requestCompression();
+            c->freeze(c->compressBlocks(version), version);
+        }
+        auto frozen = std::chrono::steady_clock::now();
+        int mismatched = 0;
+        for (size_t n = 0; n < chunks.size(); n++) {
+            coldBytes += chunks[n]->blockBytes();
+            for (unsigned int i = 0; i < 65536; i++) {
+                mismatched += chunks[n]->getBlockAt(i % 16, (i / 16) % 256, i / 4096) != blocks[n][i];
+            }
+        }
+        auto read = std::chrono::steady_clock::now();
+        for (const uPtr<Chunk> &c : chunks) {
+            c->thaw();
+        }
+        auto thawed = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < chunks.size(); n++) {
+            for (unsigned int i = 0; i < 65536; i++) {
+                mismatched += chunks[n]->getBlockAt(i % 16, (i / 16) % 256, i / 4096) != blocks[n][i];
+            }
+        }
+
+        auto perChunk = [&chunks](std::chrono::steady_clock::duration d) {
+            return std::chrono::duration<double, std::milli>(d).count() / chunks.size();
+        };
+        std::cout << biomeName(b) << ": hot " << hotBytes << " bytes, cold " << coldBytes << " bytes ("
+                  << (double(hotBytes) / coldBytes) << "x); per chunk: compress " << perChunk(frozen - start)
+                  << " ms, read every block cold " << perChunk(read - frozen) << " ms, thaw "
+                  << perChunk(thawed - read) << " ms; " << mismatched << " blocks differ" << std::endl;
+        ok = ok && mismatched == 0;
+    }
+    return ok;
+}
+
+// Meshes every Chunk of one zone per biome with both meshers and reports
+// the average vertex count, index count and meshing time per Chunk
+static void benchmarkMeshing() {
+    std::cout << "== Meshing per chunk ==" << std::endl;
+    MeshingMode prevMode = Chunk::getMeshingMode();
+    for (BiomeType b : {GRASSLANDS, MOUNTAINS, VOLCANO}) {
+        std::vector<uPtr<Chunk>> chunks = generateZone(findZoneWithBiome(b));
+        linkZone(chunks);
+        for (MeshingMode mode : {NAIVE_MESHING, GREEDY_MESHING, BITMASK_MESHING}) {
+            Chunk::setMeshingMode(mode);
+            size_t verts = 0, indices = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const uPtr<Chunk> &c : chunks) {
+                std::vector<ChunkVertex> vboOpaque, vboTransparent;
+                std::vector<GLuint> idxOpaque, idxTransparent;
+                c->makeDrawableVBOs(vboOpaque, idxOpaque, vboTransparent, idxTransparent);
+                verts += vboOpaque.size() + vboTransparent.size();
+                indices += idxOpaque.size() + idxTransparent.size();
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << biomeName(b) << " " << meshingModeName(mode)
+                      << verts / chunks.size() << " vertices, "
+                      << indices / chunks.size() << " indices, "
+                      << ms / chunks.size() << " ms per chunk" << std::endl;
+        }
+    }
+    Chunk::setMeshingMode(prevMode);
+}
+
+// The quads of a mesh as sorted lists of their four packed vertices,
+// so that meshes can be compared regardless of the order quads were emitted in
+static std::vector<std::array<ChunkVertex, 4>> sortedQuads(const std::vector<ChunkVertex> &vbo) {
+    std::vector<std::array<ChunkVertex, 4>> quads;
+    for (size_t i = 0; i + 3 < vbo.size(); i += 4) {
+        quads.push_back({vbo[i], vbo[i + 1], vbo[i + 2], vbo[i + 3]});
+    }
+    auto less = [](const std::array<ChunkVertex, 4> &a, const std::array<ChunkVertex, 4> &b) {
+        for (int k = 0; k < 4; k++) {
+            if (a[k] != b[k]) {
+                return a[k].x < b[k].x || (a[k].x == b[k].x && a[k].y < b[k].y);
+            }
+        }
+        return false;
+    };
+    std::sort(quads.begin(), quads.end(), less);
+    return quads;
+}
+
+// Checks that the bitmask mesher emits exactly the quads of the naive one,
+// on generated terrain and again after scattering random blocks through it.
+// Returns false if any Chunk's quads differ.
+static bool checkBitmaskMeshing() {
+    std::cout << "== Bitmask mesher against naive ==" << std::endl;
+    MeshingMode prevMode = Chunk::getMeshingMode();
+    bool ok = true;
+    for (BiomeType b : {GRASSLANDS, MOUNTAINS, VOLCANO}) {
+        std::vector<uPtr<Chunk>> chunks = generateZone(findZoneWithBiome(b));
+        linkZone(chunks);
+        int mismatched = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            if (pass == 1) {
+                unsigned int seed = 7;
+                for (int i = 0; i < 20000; i++) {
+                    seed = seed * 1103515245u + 12345u;
+                    // Every block type up to OBSIDIAN
+                    BlockType t = static_cast<BlockType>((seed >> 24) % (OBSIDIAN + 1));
+                    chunks[(seed >> 4) % chunks.size()]->setBlockAt(seed % 16, (seed >> 8) % 256, (seed >> 16) % 16, t);
+                }
+            }
+            for (const uPtr<Chunk> &c : chunks) {
+                std::vector<ChunkVertex> naiveOpaque, naiveTransparent, maskOpaque, maskTransparent;
+                std::vector<GLuint> idx;
+                Chunk::setMeshingMode(NAIVE_MESHING);
+                c->makeDrawableVBOs(naiveOpaque, idx, naiveTransparent, idx);
+                Chunk::setMeshingMode(BITMASK_MESHING);
+                c->makeDrawableVBOs(maskOpaque, idx, maskTransparent, idx);
+                if (sortedQuads(naiveOpaque) != sortedQuads(maskOpaque) ||
+                    sortedQuads(naiveTransparent) != sortedQuads(maskTransparent)) {
+                    mismatched++;
+                }
+            }
+        }
+        std::cout << biomeName(b) << ": " << mismatched << " of " << 2 * chunks.size()
+                  << " chunks differ" << std::endl;
+        ok = ok && mismatched == 0;
+    }
+    Chunk::setMeshingMode(prevMode);
+    return ok;
+}
+
+// Edits blocks at random, mostly around the top of their columns, and checks
+// that every Chunk's heightmaps still match a scan of its blocks. Also times
+// finding the top of every column of a zone both ways. Returns false if any
+// column's heights differ.
+static bool checkHeightmaps() {
+    std::cout << "== Heightmaps against column scans ==" << std::endl;
+    bool ok = true;
+    for (BiomeType b : {GRASSLANDS, MOUNTAINS, VOLCANO}) {
+        std::vector<uPtr<Chunk>> chunks = generateZone(findZoneWithBiome(b));
+        unsigned int seed = 11;
+        for (int i = 0; i < 50000; i++) {
+            seed = seed * 1103515245u + 12345u;
+            Chunk &c = *chunks[(seed >> 4) % chunks.size()];
+            unsigned int x = seed % 16, z = (seed >> 16) % 16;
+            int y = c.getHeightAt(TOP_NON_AIR, x, z) + static_cast<int>((seed >> 8) % 7) - 3;
+            BlockType t = static_cast<BlockType>((seed >> 24) % (OBSIDIAN + 1));
+            c.setBlockAt(x, glm::clamp(y, 0, 255), z, t);
+        }
+
+        // Top opaque and top non-air height of every column, found by scanning down
+        std::vector<int> scanned, looked;
+        auto start = std::chrono::steady_clock::now();
+        for (const uPtr<Chunk> &c : chunks) {
+            for (unsigned int i = 0; i < 256; i++) {
+                int opaque = -1, nonAir = -1;
+                for (int y = 255; y >= 0 && opaque == -1; y--) {
+                    BlockType t = c->getBlockAt(i % 16, static_cast<unsigned int>(y), i / 16);
+                    if (nonAir == -1 && t != EMPTY) {
+                        nonAir = y;
+                    }
+                    if (!blockProperties(t).transparent) {
+                        opaque = y;
+                    }
+                }
+                scanned.push_back(opaque);
+                scanned.push_back(nonAir);
+            }
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for (const uPtr<Chunk> &c : chunks) {
+            for (unsigned int i = 0; i < 256; i++) {
+                looked.push_back(c->getHeightAt(TOP_OPAQUE, i % 16, i / 16));
+                looked.push_back(c->getHeightAt(TOP_NON_AIR, i % 16, i / 16));
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        int mismatched = 0;
+        for (size_t i = 0; i < scanned.size(); i += 2) {
+            if (scanned[i] != looked[i] || scanned[i + 1] != looked[i + 1]) {
+                mismatched++;
+            }
+        }
+        std::cout << biomeName(b) << ": " << mismatched << " of " << 256 * chunks.size()
+                  << " columns differ; scanning a zone takes "
+                  << std::chrono::duration<double, std::micro>(mid - start).count() << " us, its heightmaps "
+                  << std::chrono::duration<double, std::micro>(end - mid).count() << " us" << std::endl;
+        ok = ok && mismatched == 0;
+    }
+    return ok;
+}
+
+// Counts the heap allocations needed to mesh every Chunk of one zone per biome,
+// first into fresh vectors as create_chunks used to, then through the buffer pool
+// once it has seen a few meshes of each biome
+static void benchmarkMeshPool() {
+    std::cout << "== Mesh buffer allocations per chunk ==" << std::endl;
+    for (BiomeType b : {GRASSLANDS, MOUNTAINS, VOLCANO}) {
+        std::vector<uPtr<Chunk>> chunks = generateZone(findZoneWithBiome(b));
+        linkZone(chunks);
+
+        int fresh = 0;
+        for (const uPtr<Chunk> &c : chunks) {
+            std::vector<ChunkVertex> vboOpaque, vboTransparent;
+            std::vector<GLuint> idxOpaque, idxTransparent;
+            c->makeDrawableVBOs(vboOpaque, idxOpaque, vboTransparent, idxTransparent);
+            fresh += MeshBufferPool::growthAllocations(0, vboOpaque.capacity())
+                     + MeshBufferPool::growthAllocations(0, idxOpaque.capacity())
+                     + MeshBufferPool::growthAllocations(0, vboTransparent.capacity())
+                     + MeshBufferPool::growthAllocations(0, idxTransparent.capacity());
+        }
+
+        // Warm the pool up, then count one more pass
+        int pooled = 0;
+        for (int pass = 0; pass < 4; pass++) {
+            Chunk::getBufferPool().takeAllocations();
+            for (const uPtr<Chunk> &c : chunks) {
+                ChunkVBOData data(c.get(), 0);
+                c->makeDrawableVBOs(data);
+                Chunk::releaseVBOData(data);
+            }
+            pooled = Chunk::getBufferPool().takeAllocations();
+        }
+        std::cout << biomeName(b) << ": fresh vectors " << float(fresh) / chunks.size()
+                  << ", pooled " << float(pooled) / chunks.size() << std::endl;
+    }
+}
+
+// Builds a mesh about the size of an average greedy meshed Chunk
+static void fakeMesh(std::vector<ChunkVertex> &vbo, std::vector<GLuint> &idx) {
+    vbo.assign(6000, ChunkVertex(1, 2));
+    idx.assign(9000, 3);
+}
+
+// Hands meshes from the given number of producer threads to one consumer,
+// either the old way (copied into a vector guarded by a mutex) or through
+// the lock-free MPSCQueue, and returns the time in ms until all are consumed
+static double timeHandoff(int producers, int meshesPerProducer, bool lockFree) {
+    std::vector<ChunkVBOData> shared;
+    std::mutex sharedMutex;
+    MPSCQueue<ChunkVBOData> queue;
+    std::atomic_int running(producers);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(std::thread([&]() {
+            for (int i = 0; i < meshesPerProducer; i++) {
+                if (lockFree) {
+                    ChunkVBOData d(nullptr, 0);
+                    fakeMesh(d.vboDataOpaque, d.idxDataOpaque);
+                    queue.push(std::move(d));
+                } else {
+                    // What create_chunks used to do: mesh into locals,
+                    // copy them into a ChunkVBOData, then copy that into the vector
+                    std::vector<ChunkVertex> vbo;
+                    std::vector<GLuint> idx;
+                    fakeMesh(vbo, idx);
+                    ChunkVBOData d(nullptr, 0);
+                    d.vboDataOpaque = vbo;
+                    d.idxDataOpaque = idx;
+                    sharedMutex.lock();
+                    shared.push_back(d);
+                    sharedMutex.unlock();
+                }
+            }
+            running--;
+        }));
+    }
+
+    // The consumer plays the main thread, taking whatever is ready
+    size_t consumed = 0, total = producers * meshesPerProducer;
+    std::vector<ChunkVBOData> taken;
+    while (consumed < total) {
+        if (lockFree) {
+            queue.popAll(taken);
+        } else {
+            sharedMutex.lock();
+            for (ChunkVBOData &d : shared) {
+                taken.push_back(std::move(d));
+            }
+            shared.clear();
+            sharedMutex.unlock();
+        }
+        consumed += taken.size();
+        taken.clear();
+        if (running.load() > 0) {
+            std::this_thread::yield();
+        }
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Compares handing finished meshes from the workers to the main thread
+// through a mutex guarded vector against the lock-free MPSCQueue
+static void benchmarkHandoff() {
+    std::cout << "== Mesh handoff (2048 meshes) ==" << std::endl;
+    for (int producers : {5, 8, 16}) {
+        int perProducer = 2048 / producers;
+        double locked = timeHandoff(producers, perProducer, false);
+        double lockFree = timeHandoff(producers, perProducer, true);
+        std::cout << producers << " producers: mutex + copies " << locked
+                  << " ms, lock-free + moves " << lockFree << " ms" << std::endl;
+    }
+}
+
+// Times what breaking one block on a chunk border used to cost (re-meshing
+// the chunk and its four neighbors in full) against re-meshing only the
+// sections the edit touches, and counts how often a section outgrew its slot
+static void benchmarkBlockEdit() {
+    std::cout << "== Block edit re-meshing ==" << std::endl;
+    std::vector<uPtr<Chunk>> chunks = generateZone(findZoneWithBiome(GRASSLANDS));
+    linkZone(chunks);
+    // An inner chunk, so that all four neighbors exist
+    Chunk* c = chunks[4 * 1 + 1].get();
+    std::array<Chunk*, 5> remeshed = {c, chunks[4 * 0 + 1].get(), chunks[4 * 2 + 1].get(),
+                                      chunks[4 * 1 + 0].get(), chunks[4 * 1 + 2].get()};
+
+    ChunkVBOData layout(c, 0);
+    c->makeDrawableVBOs(layout);
+
+    // Dig a shaft down the chunk's x = 0 border from the surface
+    int surface = 255;
+    while (surface > 0 && c->getBlockAt(0, surface, 8) == EMPTY) {
+        surface--;
+    }
+    const int edits = std::min(64, surface - 1);
+    double fullMs = 0, sectionMs = 0;
+    int outgrown = 0;
+    for (int i = 0; i < edits; i++) {
+        int y = surface - i;
+        c->setBlockAt(0u, static_cast<unsigned int>(y), 8u, EMPTY);
+
+        auto start = std::chrono::steady_clock::now();
+        for (Chunk* r : remeshed) {
+            ChunkVBOData data(r, 0);
+            r->makeDrawableVBOs(data);
+            Chunk::releaseVBOData(data);
+        }
+        fullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // The edited section, the one below if the block sits on its floor,
+        // and the same section of the neighbor across the x = 0 border
+        start = std::chrono::steady_clock::now();
+        std::vector<std::pair<Chunk*, int>> sections = {{c, y >> 4}, {remeshed[1], y >> 4}};
+        if ((y & 15) == 0) {
+            sections.push_back({c, (y >> 4) - 1});
+        }
+        for (auto &s : sections) {
+            ChunkVBOData data(s.first, 0);
+            s.first->makeSectionVBOs(data, s.second);
+            if (s.first == c && (data.vboDataOpaque.size() > layout.slotsOpaque[s.second].vertexCapacity ||
+                                 data.vboDataTransparent.size() > layout.slotsTransparent[s.second].vertexCapacity)) {
+                outgrown++;
+            }
+            Chunk::releaseVBOData(data);
+        }
+        sectionMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    Chunk::releaseVBOData(layout);
+    std::cout << "5 full chunks: " << fullMs / edits << " ms per edit, affected sections: "
+              << sectionMs / edits << " ms per edit, " << outgrown << " of " << edits
+              << " edits outgrew the slot laid out before digging" << std::endl;
+}
+
+// A linear congruential generator's next value, modulo n
+static int nextRandom(unsigned int &seed, int n) {
+    seed = seed * 1103515245u + 12345u;
+    return static_cast<int>((seed >> 8) % n);
+}
+
+// Meshes the Chunks of a zone on several threads while this thread keeps
+// editing blocks along their borders and re-linking them, as the game does.
+// Then walks a Terrain across new zones so its workers keep generating
+// Chunks, while this thread, as the game's main thread, reads blocks all
+// around through Terrain::getBlockAt and TerrainView between ticks.
+// Build with CONFIG+=thread_sanitizer to have ThreadSanitizer check that
+// meshing only ever reads its snapshot, and that the main thread never reads
+// the blocks of a Chunk a worker is still writing. Also checks that every
+// mesh's indices stay within its vertices, returning false if any does not.
+static bool stressSnapshotMeshing() {
+    std::cout << "== Meshing while editing ==" << std::endl;
+    std::vector<uPtr<Chunk>> chunks = generateZone(findZoneWithBiome(GRASSLANDS));
+    linkZone(chunks);
+
+    const int numThreads = 4, rounds = 8;
+    std::atomic_int meshes(0), badMeshes(0), running(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.push_back(std::thread([&, t]() {
+            for (int r = 0; r < rounds; r++) {
+                for (size_t i = t; i < chunks.size(); i += numThreads) {
+                    ChunkVBOData data(chunks[i].get(), 0);
+                    if (r % 2 == 0) {
+                        chunks[i]->makeDrawableVBOs(data);
+                    } else {
+                        chunks[i]->makeSectionVBOs(data, 8 + r % 4);
+                    }
+                    for (GLuint idx : data.idxDataOpaque) {
+                        if (idx >= data.vboDataOpaque.size()) {
+                            badMeshes++;
+                            break;
+                        }
+                    }
+                    Chunk::releaseVBOData(data);
+                    meshes++;
+                }
+            }
+            running--;
+        }));
+    }
+
+    int edits = 0;
+    unsigned int seed = 1;
+    while (running.load() > 0) {
+        seed = seed * 1103515245u + 12345u;
+        Chunk* c = chunks[(seed >> 8) % chunks.size()].get();
+        unsigned int x = (seed & 1) ? 15 : 0, z = (seed >> 4) % 16, y = 120 + (seed >> 12) % 40;
+        c->setBlockAt(x, y, z, (seed & 2) ? EMPTY : GLASS);
+        if (edits % 64 == 0) {
+            linkZone(chunks);
+        }
+        edits++;
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    std::cout << meshes.load() << " meshes during " << edits << " edits, "
+              << badMeshes.load() << " with out of range indices" << std::endl;
+
+    // The player moves half a Chunk a tick, so reads within 96 blocks of
+    // it keep reaching Chunks that are still being generated
+    Terrain terrain(nullptr);
+    const int reach = 96;
+    int generatedReads = 0, unloadedReads = 0;
+    for (int tick = 0; tick < 64; tick++) {
+        glm::vec3 player(8 + 8 * tick, 150, 8);
+        terrain.tick(player, glm::vec3(1, 0, 0), 1.f);
+        TerrainView view(terrain, glm::ivec3(player));
+        for (int i = 0; i < 2048; i++) {
+            int x = int(player.x) + nextRandom(seed, 2 * reach) - reach, z = int(player.z) + nextRandom(seed, 2 * reach) - reach;
+            int y = nextRandom(seed, 256);
+            if (terrain.hasChunkAt(x, z)) {
+                terrain.getBlockAt(x, y, z);
+                generatedReads++;
+            }
+            if (view.blockAt(x, y, z) == UNLOADED_BLOCK) {
+                unloadedReads++;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::cout << generatedReads << " reads of generated Chunks and " << unloadedReads
+              << " of Chunks not generated yet while the workers generated" << std::endl;
+    return badMeshes.load() == 0;
+}
+
+// Half the side of the square of Chunks loadLookupArea loads around the
+// origin: the 5 x 5 zones within CREATE_RADIUS
+#define LOOKUP_AREA_RADIUS 160
+
+// Generates the Chunks within LOOKUP_AREA_RADIUS of the origin into terrain,
+// without an OpenGL context, and centres its chunk grid on the origin
+static void loadLookupArea(Terrain &terrain) {
+    for (int x = -LOOKUP_AREA_RADIUS; x < LOOKUP_AREA_RADIUS; x += 16) {
+        for (int z = -LOOKUP_AREA_RADIUS; z < LOOKUP_AREA_RADIUS; z += 16) {
+            generateChunk(*terrain.instantiateChunkAt(x, z), terrain.getGenerationPipeline(), terrain.getTerrainGen());
+        }
+    }
+    // Centres the grid on the player without expanding the terrain
+    terrain.tick(glm::vec3(0, 128, 0), glm::vec3(0, 0, -1), 0.f);
+}
+
+// At least count cells visited by random rays near the origin, walked half
+// a block at a time, in the order a raycast through them reads them
+static std::vector<glm::ivec3> rayCells(int count) {
+    std::vector<glm::ivec3> cells;
+    unsigned int seed = 2;
+    while (cells.size() < static_cast<size_t>(count)) {
+        glm::vec3 p(nextRandom(seed, 64) - 32, 64 + nextRandom(seed, 128), nextRandom(seed, 64) - 32);
+        glm::vec3 dir = glm::normalize(glm::vec3(nextRandom(seed, 201) - 100, nextRandom(seed, 201) - 100,
+                                                 nextRandom(seed, 201) - 100) + 0.01f);
+        for (int step = 0; step < 256; step++) {
+            glm::ivec3 cell = glm::ivec3(glm::floor(p + dir * (step * 0.5f)));
+            if (cell.y < 0 || cell.y >= 256) {
+                break;
+            }
+            cells.push_back(cell);
+        }
+    }
+    return cells;
+}
+
+// Times block lookups through Terrain, which resolves Chunks with its ring
+// grid, against resolving them the way Terrain used to: a float floor
+// division and a lookup in the Chunk hash map. Random lookups are spread
+// over the 5 x 5 zones within CREATE_RADIUS; coherent ones walk along rays
+// one block at a time, like gridMarch does. Also checks that lookups agree,
+// including ones the grid has to send to the hash map after moving away,
+// and returns false if any disagree.
+static bool benchmarkChunkLookup() {
+    std::cout << "== Chunk lookup ==" << std::endl;
+    Terrain terrain(nullptr);
+    const int minXZ = -LOOKUP_AREA_RADIUS, maxXZ = LOOKUP_AREA_RADIUS;
+    loadLookupArea(terrain);
+
+    auto mapLookup = [&terrain](int x, int y, int z) {
+        int xFloor = static_cast<int>(glm::floor(x / 16.f));
+        int zFloor = static_cast<int>(glm::floor(z / 16.f));
+        const uPtr<Chunk> &c = terrain.getChunkAt(16 * xFloor, 16 * zFloor);
+        return c->getBlockAt(static_cast<unsigned int>(x - 16 * xFloor), static_cast<unsigned int>(y),
+                             static_cast<unsigned int>(z - 16 * zFloor));
+    };
+
+    const int lookups = 1 << 22;
+    std::vector<glm::ivec3> random, coherent = rayCells(lookups);
+    unsigned int seed = 1;
+    for (int i = 0; i < lookups; i++) {
+        random.push_back(glm::ivec3(minXZ + nextRandom(seed, maxXZ - minXZ), nextRandom(seed, 256),
+                                    minXZ + nextRandom(seed, maxXZ - minXZ)));
+    }
+
+    int mismatched = 0;
+    for (auto *cells : {&random, &coherent}) {
+        unsigned int sumMap = 0, sumGrid = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const glm::ivec3 &c : *cells) {
+            sumMap += mapLookup(c.x, c.y, c.z);
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for (const glm::ivec3 &c : *cells) {
+            sumGrid += terrain.getBlockAt(c.x, c.y, c.z);
+        }
+        auto end = std::chrono::steady_clock::now();
+        mismatched += sumMap != sumGrid;
+        auto nsPer = [cells](std::chrono::steady_clock::duration d) {
+            return std::chrono::duration<double, std::nano>(d).count() / cells->size();
+        };
+        std::cout << (cells == &random ? "random:   " : "coherent: ") << "hash map " << nsPer(mid - start)
+                  << " ns, ring grid " << nsPer(end - mid) << " ns per lookup" << std::endl;
+    }
+
+    // Move the grid away so that half of the loaded Chunks fall outside it
+    terrain.tick(glm::vec3(160, 128, 0), glm::vec3(0, 0, -1), 0.f);
+    for (int i = 0; i < 1 << 16; i++) {
+        const glm::ivec3 &c = random[i];
+        mismatched += mapLookup(c.x, c.y, c.z) != terrain.getBlockAt(c.x, c.y, c.z);
+    }
+    mismatched += terrain.hasChunkAt(maxXZ, 0) || terrain.hasChunkAt(minXZ - 1, 0) || !terrain.hasChunkAt(minXZ, maxXZ - 1);
+    std::cout << mismatched << " lookups disagree" << std::endl;
+    return mismatched == 0;
+}
+
+// Times the block reads of gridMarch, Player::computePhysics and
+// Terrain::buildTree as they were done through Terrain, resolving the Chunk
+// on every call, against doing them through a TerrainView, and checks that
+// both read the same blocks. Returns false if they do not.
+static bool benchmarkTerrainView() {
+    std::cout << "== Terrain view ==" << std::endl;
+    Terrain terrain(nullptr);
+    loadLookupArea(terrain);
+    const int points = 1 << 16;
+    std::vector<glm::ivec3> cells = rayCells(1 << 22), centres;
+    unsigned int seed = 3;
+    for (int i = 0; i < points; i++) {
+        centres.push_back(glm::ivec3(nextRandom(seed, 256) - 128, 4 + nextRandom(seed, 248), nextRandom(seed, 256) - 128));
+    }
+    int differ = 0;
+    auto timeIt = [&differ](const char* name, auto before, auto after) {
+        auto start = std::chrono::steady_clock::now();
+        unsigned int sumBefore = before();
+        auto mid = std::chrono::steady_clock::now();
+        unsigned int sumAfter = after();
+        auto end = std::chrono::steady_clock::now();
+        std::cout << name << "Terrain " << std::chrono::duration<double, std::milli>(mid - start).count()
+                  << " ms, TerrainView " << std::chrono::duration<double, std::milli>(end - mid).count() << " ms"
+                  << (sumBefore == sumAfter ? "" : " (blocks differ!)") << std::endl;
+        differ += sumBefore != sumAfter;
+    };
+
+    // gridMarch: a hasChunkAt and a getBlockAt per cell of the ray
+    timeIt("raycast cells:       ", [&]() {
+        unsigned int sum = 0;
+        for (const glm::ivec3 &c : cells) {
+            if (terrain.hasChunkAt(c.x, c.z)) {
+                sum += terrain.getBlockAt(c.x, c.y, c.z);
+            }
+        }
+        return sum;
+    }, [&]() {
+        unsigned int sum = 0;
+        TerrainView view(terrain, cells[0]);
+        for (const glm::ivec3 &c : cells) {
+            view.moveTo(c);
+            BlockType t = view.get();
+            if (t != UNLOADED_BLOCK) {
+                sum += t;
+            }
+        }
+        return sum;
+    });
+
+    // computePhysics: the blocks around the player's body, 3 x 4 x 3 per frame
+    timeIt("physics boxes:       ", [&]() {
+        unsigned int sum = 0;
+        for (const glm::ivec3 &p : centres) {
+            for (int z = -1; z <= 1; z++) {
+                for (int y = -1; y <= 2; y++) {
+                    for (int x = -1; x <= 1; x++) {
+                        sum += terrain.getBlockAt(p.x + x, p.y + y, p.z + z);
+                    }
+                }
+            }
+        }
+        return sum;
+    }, [&]() {
+        unsigned int sum = 0;
+        TerrainView view(terrain, centres[0]);
+        std::array<BlockType, 36> box;
+        for (const glm::ivec3 &p : centres) {
+            view.moveTo(p);
+            view.read(glm::ivec3(-1), glm::ivec3(3, 4, 3), box.data());
+            for (BlockType t : box) {
+                sum += t;
+            }
+        }
+        return sum;
+    });
+
+    // buildTree: the Chunk of every block of a radius 3 ball of leaves
+    timeIt("tree leaf Chunks:    ", [&]() {
+        unsigned int sum = 0;
+        for (int i = 0; i < points / 16; i++) {
+            const glm::ivec3 &p = centres[i];
+            for (int x = -3; x < 4; x++) {
+                for (int y = -3; y < 4; y++) {
+                    for (int z = -3; z < 4; z++) {
+                        if (terrain.hasChunkAt(p.x + x, p.z + z)) {
+                            sum += terrain.getChunkAt(p.x + x, p.z + z)->getMinPos().x & 255;
+                        }
+                    }
+                }
+            }
+        }
+        return sum;
+    }, [&]() {
+        unsigned int sum = 0;
+        TerrainView view(terrain, centres[0]);
+        for (int i = 0; i < points / 16; i++) {
+            const glm::ivec3 &p = centres[i];
+            for (int x = -3; x < 4; x++) {
+                for (int y = -3; y < 4; y++) {
+                    for (int z = -3; z < 4; z++) {
+                        view.moveTo(p + glm::ivec3(x, y, z));
+                        if (view.getChunk() != nullptr) {
+                            sum += view.getChunk()->getMinPos().x & 255;
+                        }
+                    }
+                }
+            }
+        }
+        return sum;
+    });
+    return differ == 0;
+}
+
+// Times the column heights of whole Chunks evaluated one getHeight call per
+// column, as Chunk generation used to, against getHeights over a Chunk and
+// over a zone at a time. Also counts the columns where they disagree, which
+// getHeights documents may happen right on a block or biome boundary.
+static void benchmarkHeights() {
+    std::cout << "== Column heights ==" << std::endl;
+    std::vector<glm::ivec2> zones = {findZoneWithBiome(GRASSLANDS), findZoneWithBiome(MOUNTAINS),
+                                     findZoneWithBiome(VOLCANO)};
+    unsigned int seed = 5;
+    while (zones.size() < 64) {
+        zones.push_back(glm::ivec2(64 * (nextRandom(seed, 2000) - 1000), 64 * (nextRandom(seed, 2000) - 1000)));
+    }
+    const size_t columns = zones.size() * 64 * 64;
+    std::vector<ColumnHeight> scalar(columns), chunked(columns), zoned(columns);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < zones.size(); i++) {
+        for (int z = 0; z < 64; z++) {
+            for (int x = 0; x < 64; x++) {
+                std::tuple<int, BiomeType, bool> h = defaultGen.getHeight(glm::vec2(zones[i] + glm::ivec2(x, z)));
+                scalar[i * 4096 + x + 64 * z] = ColumnHeight{std::get<0>(h), std::get<1>(h), std::get<2>(h)};
+            }
+        }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    std::array<ColumnHeight, 256> chunk;
+    for (size_t i = 0; i < zones.size(); i++) {
+        for (int cz = 0; cz < 64; cz += 16) {
+            for (int cx = 0; cx < 64; cx += 16) {
+                defaultGen.getHeights(zones[i] + glm::ivec2(cx, cz), glm::ivec2(16), chunk.data());
+                for (int z = 0; z < 16; z++) {
+                    std::copy_n(&chunk[16 * z], 16, &chunked[i * 4096 + cx + 64 * (cz + z)]);
+                }
+            }
+        }
+    }
+    auto mid2 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < zones.size(); i++) {
+        defaultGen.getHeights(zones[i], glm::ivec2(64), &zoned[i * 4096]);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    auto chunksPerSecond = [&zones](std::chrono::steady_clock::duration d) {
+        return 16 * zones.size() / std::chrono::duration<double>(d).count();
+    };
+    std::cout << "getHeight per column " << chunksPerSecond(mid - start) << " chunks/s, getHeights per Chunk "
+              << chunksPerSecond(mid2 - mid) << " chunks/s, per zone " << chunksPerSecond(end - mid2)
+              << " chunks/s" << std::endl;
+
+    int heights = 0, biomes = 0, holes = 0, maxDiff = 0, batches = 0;
+    for (size_t i = 0; i < columns; i++) {
+        int diff = std::abs(scalar[i].height - chunked[i].height);
+        heights += diff != 0;
+        maxDiff = std::max(maxDiff, diff);
+        biomes += scalar[i].biome != chunked[i].biome;
+        holes += scalar[i].vFlip != chunked[i].vFlip;
+        batches += chunked[i].height != zoned[i].height || chunked[i].biome != zoned[i].biome
+                   || chunked[i].vFlip != zoned[i].vFlip;
+    }
+    std::cout << "of " << columns << " columns, " << heights << " heights (at most " << maxDiff << " apart), "
+              << biomes << " biomes and " << holes << " volcano holes differ from getHeight; "
+              << batches << " differ between Chunk and zone batches" << std::endl;
+}
+
+// Generates the same Chunks with cave noise sampled every block, which is
+// exact, and on coarser lattices, timing each and counting the blocks
+// below y = 150 that come out differently from the exact caves
+static void benchmarkCaves() {
+    std::cout << "== Cave sampling ==" << std::endl;
+    std::vector<glm::ivec2> zones = {findZoneWithBiome(GRASSLANDS), findZoneWithBiome(MOUNTAINS),
+                                     findZoneWithBiome(VOLCANO)};
+    unsigned int seed = 7;
+    while (zones.size() < 8) {
+        zones.push_back(glm::ivec2(64 * (nextRandom(seed, 2000) - 1000), 64 * (nextRandom(seed, 2000) - 1000)));
+    }
+    // Cave blocks are those left empty or lava below a solid block of their column
+    auto caveBlocks = [](const Chunk &c) {
+        int count = 0;
+        for (int x = 0; x < 16; x++) {
+            for (int z = 0; z < 16; z++) {
+                bool covered = false;
+                for (int y = 149; y > 0; y--) {
+                    BlockType t = c.getBlockAt(x, y, z);
+                    covered = covered || (t != EMPTY && t != WATER && t != LAVA);
+                    count += covered && (t == EMPTY || t == LAVA);
+                }
+            }
+        }
+        return count;
+    };
+
+    std::vector<uPtr<Chunk>> exact;
+    int exactCaves = 0;
+    for (int spacing : {1, 2, 4, 8}) {
+        TerrainGen gen(0.f, TRIG_HASH, spacing);
+        std::vector<uPtr<Chunk>> chunks;
+        auto start = std::chrono::steady_clock::now();
+        for (const glm::ivec2 &zone : zones) {
+            std::vector<uPtr<Chunk>> zoneChunks = generateZone(zone, gen);
+            std::move(zoneChunks.begin(), zoneChunks.end(), std::back_inserter(chunks));
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        int caves = 0, differ = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            caves += caveBlocks(*chunks[i]);
+            for (int x = 0; x < 16 && spacing != 1; x++) {
+                for (int z = 0; z < 16; z++) {
+                    for (int y = 0; y < 150; y++) {
+                        differ += chunks[i]->getBlockAt(x, y, z) != exact[i]->getBlockAt(x, y, z);
+                    }
+                }
+            }
+        }
+        if (spacing == 1) {
+            exact = std::move(chunks);
+            exactCaves = caves;
+        }
+        std::cout << "every " << spacing << " blocks: " << ms / (16 * zones.size()) << " ms per Chunk, "
+                  << caves << " cave blocks, " << differ << " blocks differ from exact ("
+                  << 100.0 * differ / std::max(exactCaves, 1) << "% of its cave blocks)" << std::endl;
+    }
+}
+
+// FNV-1a step
+static void fnvMix(uint32_t &h, uint32_t word) {
+    h = (h ^ word) * 16777619u;
+}
+
+// FNV-1a of every block of c
+static uint32_t chunkFingerprint(const Chunk &c) {
+    uint32_t h = 2166136261u;
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            for (int y = 0; y < 256; y++) {
+                fnvMix(h, c.getBlockAt(x, y, z));
+            }
+        }
+    }
+    return h;
+}
+
+// FNV-1a of the bits of the lattice hashes around the origin, and of the
+// blocks of one generated Chunk, under the given seed and noise hash
+static std::pair<uint32_t, uint32_t> noiseHashFingerprint(int seed, NoiseHash hash) {
+    TerrainGen gen(seed, hash);
+    uint32_t lattice = 2166136261u;
+    auto bits = [](float f) {
+        uint32_t b;
+        std::memcpy(&b, &f, sizeof(b));
+        return b;
+    };
+    for (int x = -32; x < 32; x++) {
+        for (int z = -32; z < 32; z++) {
+            glm::vec2 r2 = gen.random2(glm::vec2(x, z));
+            glm::vec3 r3 = gen.random3(glm::vec3(x, z % 8, z));
+            for (float f : {r2.x, r2.y, r3.x, r3.y, r3.z}) {
+                fnvMix(lattice, bits(f));
+            }
+        }
+    }
+    Chunk c(nullptr, 48, -32, 0);
+    generateChunk(c, GenerationPipeline::defaultPipeline(), gen);
+    return {lattice, chunkFingerprint(c)};
+}
+
+// Checks the integer noise hash against the lattices and Chunks it gave when
+// it was written; a change here changes every INTEGER_HASH world. Then times
+// lattice hashes and Chunk generation with each hash. Returns false if any
+// fingerprint differs.
+static bool checkNoiseHash() {
+    std::cout << "== Noise hash ==" << std::endl;
+    struct Golden {
+        int seed;
+        uint32_t lattice, blocks;
+    };
+    const Golden goldens[] = {
+        {0, 0x016aa930u, 0xbd7f1761u},
+        {1, 0x630afa53u, 0x6bc6e847u},
+        {-7, 0x6599d45du, 0x230deabbu},
+        {123456, 0xdd45a741u, 0xb1601ae5u},
+    };
+    bool ok = true;
+    for (const Golden &g : goldens) {
+        std::pair<uint32_t, uint32_t> got = noiseHashFingerprint(g.seed, INTEGER_HASH);
+        ok = ok && got.first == g.lattice && got.second == g.blocks;
+        std::cout << "seed " << g.seed << ": lattice " << (got.first == g.lattice ? "matches" : "DIFFERS")
+                  << ", Chunk " << (got.second == g.blocks ? "matches" : "DIFFERS") << std::hex
+                  << " (" << got.first << ", " << got.second << ")" << std::dec << std::endl;
+    }
+
+    const int points = 1 << 20;
+    for (NoiseHash hash : {TRIG_HASH, INTEGER_HASH}) {
+        TerrainGen gen(0.f, hash);
+        float sum = 0.f;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < points; i++) {
+            glm::vec2 r2 = gen.random2(glm::vec2(i & 1023, i >> 10));
+            glm::vec3 r3 = gen.random3(glm::vec3(i & 1023, i >> 10, i & 7));
+            sum += r2.x + r3.x;
+        }
+        auto mid = std::chrono::steady_clock::now();
+        std::vector<uPtr<Chunk>> chunks = generateZone(glm::ivec2(0, 0), gen);
+        auto end = std::chrono::steady_clock::now();
+        std::cout << (hash == TRIG_HASH ? "trig hash:    " : "integer hash: ")
+                  << std::chrono::duration<double, std::nano>(mid - start).count() / points
+                  << " ns per random2 + random3, "
+                  << 16 / std::chrono::duration<double>(end - mid).count() << " chunks/s"
+                  << (sum < 0.f ? " " : "") << std::endl;
+    }
+    return ok;
+}
+
+// Generates the same zones of several worlds, each with its own seed, one
+// world after another and then all at once on their own threads, the way a
+// tool pregenerating worlds would, and checks that every Chunk comes out
+// the same either way. Returns false if any world differs between the two,
+// or comes out the same as another world despite its own seed.
+static bool checkConcurrentWorlds() {
+    std::cout << "== Concurrent worlds ==" << std::endl;
+    const int worlds = 4;
+    std::vector<TerrainGen> gens;
+    for (int i = 0; i < worlds; i++) {
+        gens.push_back(TerrainGen(1000 * i + 17, i % 2 ? INTEGER_HASH : TRIG_HASH));
+    }
+    const std::vector<glm::ivec2> zones = {glm::ivec2(0, 0), glm::ivec2(-64, 128), glm::ivec2(320, -64)};
+    auto generateWorld = [&zones](const TerrainGen &gen, std::vector<uint32_t> &fingerprints) {
+        for (const glm::ivec2 &zone : zones) {
+            for (const uPtr<Chunk> &c : generateZone(zone, gen)) {
+                fingerprints.push_back(chunkFingerprint(*c));
+            }
+        }
+    };
+
+    std::vector<std::vector<uint32_t>> serial(worlds), parallel(worlds);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < worlds; i++) {
+        generateWorld(gens[i], serial[i]);
+    }
+    auto mid = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < worlds; i++) {
+        threads.emplace_back(generateWorld, std::cref(gens[i]), std::ref(parallel[i]));
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    int differ = 0, sameAcrossWorlds = 0;
+    for (int i = 0; i < worlds; i++) {
+        differ += serial[i] != parallel[i];
+        sameAcrossWorlds += i > 0 && serial[i] == serial[0];
+    }
+    std::cout << worlds << " worlds of " << 16 * zones.size() << " Chunks: one at a time "
+              << std::chrono::duration<double, std::milli>(mid - start).count() << " ms, all at once "
+              << std::chrono::duration<double, std::milli>(end - mid).count() << " ms; " << differ
+              << " worlds differ between the two, " << sameAcrossWorlds << " worlds identical to the first" << std::endl;
+    return differ == 0 && sameAcrossWorlds == 0;
+}
+
+// Times the column heights of whole zones with every term evaluated per
+// column against interpolating the low-frequency terms from each zone's
+// cached fields, and counts how far the interpolated heights stray. Also
+// reports how often the cache hits, both here and while a Terrain generates
+// the zones around the player on its threads.
+static void benchmarkZoneFields() {
+    std::cout << "== Zone fields ==" << std::endl;
+    std::vector<glm::ivec2> zones = {findZoneWithBiome(GRASSLANDS), findZoneWithBiome(MOUNTAINS),
+                                     findZoneWithBiome(VOLCANO)};
+    unsigned int seed = 9;
+    while (zones.size() < 64) {
+        zones.push_back(glm::ivec2(64 * (nextRandom(seed, 2000) - 1000), 64 * (nextRandom(seed, 2000) - 1000)));
+    }
+    const size_t columns = zones.size() * 64 * 64;
+    std::vector<ColumnHeight> exact(columns), cached(columns);
+    std::array<ColumnHeight, 256> chunk;
+    ZoneFieldCache cache;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<ColumnHeight> &out = pass == 0 ? exact : cached;
+        for (size_t i = 0; i < zones.size(); i++) {
+            for (int cz = 0; cz < 64; cz += 16) {
+                for (int cx = 0; cx < 64; cx += 16) {
+                    sPtr<const ZoneFields> fields = pass == 0 ? nullptr : cache.get(defaultGen, zones[i]);
+                    defaultGen.getHeights(zones[i] + glm::ivec2(cx, cz), glm::ivec2(16), chunk.data(), fields.get());
+                    for (int z = 0; z < 16; z++) {
+                        std::copy_n(&chunk[16 * z], 16, &out[i * 4096 + cx + 64 * (cz + z)]);
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            auto mid = std::chrono::steady_clock::now();
+            std::cout << "every term per column: " << 16 * zones.size() / std::chrono::duration<double>(mid - start).count()
+                      << " chunks/s" << std::endl;
+            start = mid;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "zone fields:           " << 16 * zones.size() / std::chrono::duration<double>(end - start).count()
+              << " chunks/s, " << cache.getHits() << " hits and " << cache.getMisses() << " misses, "
+              << 1000 * cache.getSampleMillis() / cache.getMisses() << " us to sample a zone" << std::endl;
+
+    int heights = 0, maxDiff = 0, biomes = 0, holes = 0;
+    long totalDiff = 0;
+    for (size_t i = 0; i < columns; i++) {
+        int diff = std::abs(exact[i].height - cached[i].height);
+        heights += diff != 0;
+        totalDiff += diff;
+        maxDiff = std::max(maxDiff, diff);
+        biomes += exact[i].biome != cached[i].biome;
+        holes += exact[i].vFlip != cached[i].vFlip;
+    }
+    std::cout << "of " << columns << " columns, " << heights << " heights differ (mean " << double(totalDiff) / columns
+              << ", at most " << maxDiff << " blocks), " << biomes << " biomes and " << holes << " volcano holes" << std::endl;
+
+    Terrain terrain(nullptr);
+    for (int i = 0; i < 100000; i++) {
+        terrain.tick(glm::vec3(8, 150, 8), glm::vec3(0, 0, -1), 1.f);
+        if (i > 1 && terrain.threadsIdle()) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const ZoneFieldCache &terrainCache = terrain.getZoneFieldCache();
+    std::cout << "Terrain around the origin: " << terrainCache.getHits() << " hits and "
+              << terrainCache.getMisses() << " misses, " << 1000 * terrainCache.getSampleMillis() / terrainCache.getMisses()
+              << " us to sample a zone" << std::endl;
+}
+
+// Generates Chunks of every biome through the default GenerationPipeline, once
+// with every stage on one thread and once with the column parallel stages split
+// into strips, each strip on its own thread and the last ones started first,
+// and checks that both give the same blocks. Then prints how long each stage
+// took per Chunk, here and in a Terrain generating the zones around the player.
+// Returns false if any Chunk differs.
+static bool benchmarkGenerationPipeline() {
+    std::cout << "== Generation pipeline ==" << std::endl;
+    const std::vector<glm::ivec2> zones = {findZoneWithBiome(GRASSLANDS), findZoneWithBiome(MOUNTAINS),
+                                           findZoneWithBiome(VOLCANO)};
+    GenerationPipeline pipeline = GenerationPipeline::defaultPipeline();
+    int chunks = 0, differ = 0;
+    double serialMs = 0., stripedMs = 0.;
+    for (const glm::ivec2 &zone : zones) {
+        for (int x = zone.x; x < zone.x + 64; x += 16) {
+            for (int z = zone.y; z < zone.y + 64; z += 16) {
+                auto start = std::chrono::steady_clock::now();
+                Chunk serial(nullptr, x, z, 0);
+                GenerationContext ctx(serial.getMinPos(), defaultGen, nullptr);
+                pipeline.run(ctx);
+                serial.commitGeneration(ctx);
+                auto mid = std::chrono::steady_clock::now();
+
+                Chunk striped(nullptr, x, z, 0);
+                GenerationTask task(striped.getMinPos(), defaultGen, nullptr, GENERATION_STRIPS);
+                std::vector<int> spawned;
+                auto spawnStrip = [&spawned](int i) {
+                    spawned.push_back(i);
+                };
+                std::atomic_int finished(pipeline.start(task, spawnStrip));
+                while (!finished) {
+                    std::vector<int> strips;
+                    strips.swap(spawned);
+                    // Each strip's thread keeps the strips it spawns to itself until they are all joined
+                    std::vector<std::vector<int>> next(strips.size());
+                    std::vector<std::thread> threads;
+                    for (size_t i = 0; i < strips.size(); i++) {
+                        threads.emplace_back([&, i, strip = strips[strips.size() - 1 - i]]() {
+                            // The last strip carries on alone, so it spawns the next stage's strips
+                            if (pipeline.runStrip(task, strip, [&](int s) { next[i].push_back(s); })) {
+                                finished = true;
+                            }
+                        });
+                    }
+                    for (std::thread &t : threads) {
+                        t.join();
+                    }
+                    for (const std::vector<int> &n : next) {
+                        spawned.insert(spawned.end(), n.begin(), n.end());
+                    }
+                }
+                striped.commitGeneration(task.context);
+                auto end = std::chrono::steady_clock::now();
+
+                chunks++;
+                differ += chunkFingerprint(serial) != chunkFingerprint(striped)
+                          || serial.getTrees() != striped.getTrees();
+                serialMs += std::chrono::duration<double, std::milli>(mid - start).count();
+                stripedMs += std::chrono::duration<double, std::milli>(end - mid).count();
+            }
+        }
+    }
+    std::cout << chunks << " Chunks: " << serialMs / chunks << " ms each on one thread, " << stripedMs / chunks
+              << " ms in " << GENERATION_STRIPS << " strips; " << differ << " differ" << std::endl;
+
+    Terrain terrain(nullptr);
+    for (int i = 0; i < 100000; i++) {
+        terrain.tick(glm::vec3(8, 150, 8), glm::vec3(0, 0, -1), 1.f);
+        if (i > 1 && terrain.threadsIdle()) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const GenerationPipeline *pipelines[] = {&pipeline, &terrain.getGenerationPipeline()};
+    for (const GenerationPipeline *p : pipelines) {
+        std::cout << (p == &pipeline ? "here:   " : "Terrain:");
+        for (int i = 0; i < p->stageCount(); i++) {
+            std::cout << " " << p->getStage(i).name << " "
+                      << p->getStageMillis(i) / std::max(1, p->getStageChunks(i)) << " ms";
+        }
+        std::cout << " per Chunk" << std::endl;
+    }
+    return differ == 0;
+}
+
+int runBenchmarks() {
+    // Every check runs, even after one fails
+    bool ok = true;
+    benchmarkChunkMemory();
+    ok = benchmarkColdTier() && ok;
+    benchmarkMeshing();
+    ok = checkBitmaskMeshing() && ok;
+    ok = checkHeightmaps() && ok;
+    benchmarkHandoff();
+    benchmarkMeshPool();
+    benchmarkBlockEdit();
+    ok = benchmarkChunkLookup() && ok;
+    ok = benchmarkTerrainView() && ok;
+    benchmarkHeights();
+    benchmarkCaves();
+    ok = checkNoiseHash() && ok;
+    ok = checkConcurrentWorlds() && ok;
+    benchmarkZoneFields();
+    ok = benchmarkGenerationPipeline() && ok;
+    ok = stressSnapshotMeshing() && ok;
+    if (!ok) {
+        std::cout << "A check FAILED; see the results above" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Headless benchmarks for the terrain systems. Setting the
+// MINIMINECRAFT_BENCHMARK environment variable makes main() run these
+// and print their results instead of opening the game window.
+// Returns 1 if any of their correctness checks finds a mismatch, else 0.
+int runBenchmarks();
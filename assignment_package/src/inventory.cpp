@@ -66,7 +66,8 @@ void Item::createVBOdata() {
                           glm::vec4(-0.77f + (position * 0.15), -0.77, 0.99f, 1.f),
                           glm::vec4(-0.88f + (position * 0.15), -0.77f, 0.99f, 1.f)};
 
-    glm::vec2 bottomRight = 0.0625f * block_info_map.at(type).uv_map.at(XPOS);
+    BlockTile tile = blockProperties(type).tiles[XPOS];
+    glm::vec2 bottomRight = 0.0625f * glm::vec2(tile.col, tile.row);
 
     glm::vec2 vert_UV[4] {bottomRight + glm::vec2(0.f, 0.f),
                          bottomRight + glm::vec2(0.0625f, 0.f),
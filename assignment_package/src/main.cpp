@@ -1,5 +1,6 @@
 #include <mainwindow.h>
 #include <startwindow.h>
+#include <benchmark.h>
 
 #include <QApplication>
 #include <QSurfaceFormat>
@@ -24,6 +25,9 @@ int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
+    // Print the terrain benchmarks instead of starting the game
+    if (qgetenv("MINIMINECRAFT_BENCHMARK") != nullptr) return runBenchmarks();
+
     // Set OpenGL 4.0 and, optionally, 4-sample multisampling
     QSurfaceFormat format;
     format.setVersion(4, 0);
@@ -18,6 +18,7 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->mygl, SIGNAL(sig_sendPlayerLook(QString)), &playerInfoWindow, SLOT(slot_setLookText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerChunk(QString)), &playerInfoWindow, SLOT(slot_setChunkText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerTerrainZone(QString)), &playerInfoWindow, SLOT(slot_setZoneText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendTerrainStats(QStringList)), &playerInfoWindow, SLOT(slot_setTerrainStats(QStringList)));
 
     connect(ui->mygl,SIGNAL(sig_toggleProgress()),this,SLOT(on_toggleProgress()));
     connect(ui->mygl,SIGNAL(sig_quit()),this,SLOT(on_actionQuit_triggered()));
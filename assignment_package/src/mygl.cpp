@@ -211,7 +211,7 @@ void MyGL::tick() {
         mp_player->tick(entityDt, m_inputs);
 
         // Expands terrain if player is near unloaded chunks
-        mp_terrain->tick(mp_player->mcr_position, dt);
+        mp_terrain->tick(mp_player->mcr_position, mp_player->mcr_camera.mcr_forward, dt);
         
         mp_terrain->growTrees(QDateTime::currentMSecsSinceEpoch());
 
@@ -223,6 +223,7 @@ void MyGL::tick() {
 
         update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
         sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
+        sendTerrainDataToGUI();
 
         if (mp_player->getCamInWater()) {
             this->mp_progPostCurr = &this->m_progPostWater;
@@ -234,7 +235,7 @@ void MyGL::tick() {
         break;
         
     case LOADING:
-        mp_terrain->tick(mp_player->mcr_position, dt);
+        mp_terrain->tick(mp_player->mcr_position, mp_player->mcr_camera.mcr_forward, dt);
         update();
     case CLOSING:
     case SAVING:
@@ -248,12 +249,19 @@ void MyGL::tick() {
                 emit sig_toggleProgress();
                 state = CLOSING;
                 break;
-            case LOADING:
+            case LOADING: {
+                // A new game's spawn height is a guess; lift the player out of the ground if it was too low
+                glm::vec3 pos = mp_player->mcr_position;
+                int ground = mp_terrain->getHeightAt(TOP_OPAQUE, glm::floor(pos.x), glm::floor(pos.z));
+                if (ground + 1 > pos.y) {
+                    mp_player->moveUpGlobal(ground + 1 - pos.y);
+                }
                 emit sig_toggleProgress();
                 state = PLAYING;
                 update();
                 break;
             }
+            }
         }
 
         break;
@@ -275,6 +283,54 @@ void MyGL::sendPlayerDataToGUI() const {
     emit sig_sendPlayerTerrainZone(QString::fromStdString("( " + std::to_string(zone.x) + ", " + std::to_string(zone.y) + " )"));
 }
 
+// The terrain statistics shown in the player info window, one row each
+static const struct {
+    const char *title;
+    std::string (*value)(const Terrain&);
+} terrainStats[] = {
+    // Work thrown away because its Chunk was unloaded first
+    {"Cancelled:", [](const Terrain &t) {
+        glm::ivec3 cancelled = t.getCancelledWork();
+        return std::to_string(cancelled.x) + " generations, " + std::to_string(cancelled.y) + " meshes, "
+                + std::to_string(cancelled.z) + " VBOs";
+    }},
+    {"Uploads:", [](const Terrain &t) {
+        return std::to_string(t.getUploadBacklog()) + " meshes waiting";
+    }},
+    {"Mesh allocs:", [](const Terrain &t) {
+        return std::to_string(t.getMeshAllocations()) + " last frame";
+    }},
+    {"Blocks:", [](const Terrain &t) {
+        return std::to_string(t.getBlockBytes() >> 20) + " of " + std::to_string(t.getBlockMemoryBudget() >> 20) + " MB, "
+                + std::to_string(t.getUnloadedZones()) + " zones unloaded";
+    }},
+    // Hot Chunks keep their blocks as they are, cold ones compressed
+    {"Storage:", [](const Terrain &t) {
+        ChunkStorageStats storage = t.getStorageStats();
+        std::string ratio = storage.compressedTo > 0
+                ? QString::number(double(storage.compressedFrom) / storage.compressedTo, 'f', 1).toStdString() : "-";
+        return std::to_string(storage.hotChunks) + " hot (" + std::to_string(storage.hotBytes >> 20) + " MB), "
+                + std::to_string(storage.coldChunks) + " cold (" + std::to_string(storage.coldBytes >> 20) + " MB), "
+                + ratio + "x compression";
+    }},
+    // How often the Chunks being generated found their zone's fields already sampled
+    {"Zone fields:", [](const Terrain &t) {
+        const ZoneFieldCache &fields = t.getZoneFieldCache();
+        size_t lookups = fields.getHits() + fields.getMisses();
+        return std::to_string(lookups > 0 ? 100 * fields.getHits() / lookups : 0) + "% hits, "
+                + std::to_string(fields.getMisses() > 0 ? int(1000 * fields.getSampleMillis() / fields.getMisses()) : 0)
+                + " us per zone sampled";
+    }},
+};
+
+void MyGL::sendTerrainDataToGUI() const {
+    QStringList stats;
+    for (const auto &stat : terrainStats) {
+        stats << stat.title << QString::fromStdString(stat.value(*mp_terrain));
+    }
+    emit sig_sendTerrainStats(stats);
+}
+
 // This function is called whenever update() is called.
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
@@ -418,6 +474,10 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
         this->wolf->summon();
         this->cow->summon();
         break;
+    case (Qt::Key_G):
+        // cycle through the naive, greedy and bitmask chunk meshers
+        mp_terrain->setMeshingMode(static_cast<MeshingMode>((Chunk::getMeshingMode() + 1) % (BITMASK_MESHING + 1)));
+        break;
     case (Qt::Key_Space):
         m_inputs.spacePressed = true;
         break;
@@ -718,7 +778,13 @@ void MyGL::load(QString savename) {
 
     file.close();
 
-    mp_terrain = mkU<Terrain>(this, savename);
+    // The generator is fixed before the Terrain's worker threads start
+    mp_terrain = mkU<Terrain>(this, savename, Terrain::readGenerator(savename));
+    // The block memory budget in MB, for machines with less (or more) to spare
+    int budgetMB = qgetenv("MINIMINECRAFT_BLOCK_BUDGET_MB").toInt();
+    if (budgetMB > 0) {
+        mp_terrain->setBlockMemoryBudget(size_t(budgetMB) << 20);
+    }
     mp_player = mkU<Player>(pos,*mp_terrain);
 
     state = LOADING;
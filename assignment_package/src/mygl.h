@@ -23,6 +23,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QStringList>
 
 enum State : unsigned char {
     UNINITALIZED, LOADING, PLAYING, SAVING, CLOSING
@@ -60,6 +61,8 @@ private:
                               // your mouse stays within the screen bounds and is always read.
 
     void sendPlayerDataToGUI() const;
+    // Updates the terrain statistics shown below the player data
+    void sendTerrainDataToGUI() const;
 
     qint64 m_lastFrameTime;
     qint64 m_initalTime;
@@ -133,6 +136,8 @@ signals:
     void sig_sendPlayerLook(QString) const;
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
+    // The title and value of each terrain statistic, alternating
+    void sig_sendTerrainStats(QStringList) const;
 
     void sig_toggleProgress();
     void sig_quit();
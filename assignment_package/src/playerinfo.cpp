@@ -36,3 +36,25 @@ void PlayerInfo::slot_setZoneText(QString s) {
     ui->zoneLabel->setText(s);
 }
 
+
+void PlayerInfo::slot_setTerrainStats(QStringList stats) {
+    for (int i = 0; i + 1 < stats.size(); i += 2) {
+        size_t row = i / 2;
+        if (row == m_statLabels.size()) {
+            // Each new row goes 40 pixels below the last, laid out like the ones in the form
+            int below = 40 * int(row + 1);
+            QLabel *title = new QLabel(this);
+            QLabel *value = new QLabel(this);
+            title->setGeometry(ui->label_11->geometry().translated(0, below));
+            value->setGeometry(ui->zoneLabel->geometry().translated(0, below));
+            title->setFont(ui->zoneLabel->font());
+            value->setFont(ui->zoneLabel->font());
+            title->show();
+            value->show();
+            m_statLabels.push_back({title, value});
+            resize(width(), height() + 40);
+        }
+        m_statLabels[row].first->setText(stats[i]);
+        m_statLabels[row].second->setText(stats[i + 1]);
+    }
+}
@@ -2,6 +2,9 @@
 #define PLAYERINFO_H
 
 #include <QWidget>
+#include <QLabel>
+#include <QStringList>
+#include <vector>
 
 namespace Ui {
 class PlayerInfo;
@@ -20,9 +23,12 @@ public slots:
     void slot_setLookText(QString);
     void slot_setChunkText(QString);
     void slot_setZoneText(QString);
+    void slot_setTerrainStats(QStringList);
 
 private:
     Ui::PlayerInfo *ui;
+    // Title and value labels of the terrain statistics, made when first sent
+    std::vector<std::pair<QLabel*, QLabel*>> m_statLabels;
 };
 
 #endif // PLAYERINFO_H
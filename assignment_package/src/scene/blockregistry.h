@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <stdexcept>
+#include <string>
+
+// C++ 11 allows us to define the size of an enum. This lets us use only one byte
+// of memory to store our different block types. By default, the size of a C++ enum
+// is that of an int (so, usually four bytes). This *does* limit us to only 256 different
+// block types, but in the scope of this project we'll never get anywhere near that many.
+enum BlockType : unsigned char
+{
+    EMPTY, GRASS, DIRT, STONE, WATER, SNOW, LAVA, BEDROCK, GLASS, OAK_LOG, OAK_LEAVES, OBSIDIAN, BONE
+};
+
+#define BLOCK_TYPE_COUNT (BONE + 1)
+
+// The six cardinal directions in 3D space
+enum Direction : unsigned char
+{
+    XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
+};
+
+// A 16 x 16 pixel tile of the texture atlas, counted from its lower-left corner
+struct BlockTile
+{
+    unsigned char col, row;
+};
+
+// Everything the game needs to know about one block type
+struct BlockProperties
+{
+    BlockType type;
+    // The atlas tile drawn on each face, indexed by Direction
+    std::array<BlockTile, 6> tiles;
+    // Faces behind it are still drawn, and it is meshed into the transparent pass
+    bool transparent;
+    // Its texture scrolls over time
+    bool animated;
+    // Stops the player and mobs from moving through it, and stops gridMarch
+    bool solid;
+    // Can be swum in
+    bool liquid;
+    // The byte it is stored as in .chunk save files
+    unsigned char saveId;
+};
+
+// Helper for the registry below: a block with one tile on its sides and
+// possibly different ones on top and bottom
+constexpr BlockProperties makeBlock(BlockType type, BlockTile side, BlockTile top, BlockTile bottom,
+                                    bool transparent, bool animated, bool solid, bool liquid,
+                                    unsigned char saveId)
+{
+    return {type, {{side, side, top, bottom, side, side}}, transparent, animated, solid, liquid, saveId};
+}
+
+// The block registry, one entry per BlockType in enum order. New block
+// types are added here and nowhere else; checked at compile time below.
+constexpr std::array<BlockProperties, BLOCK_TYPE_COUNT> block_registry {{
+    //        type        side      top       bottom    transp. animated solid  liquid saveId
+    makeBlock(EMPTY,      {13, 2},  {13, 2},  {13, 2},  true,   false,   false, false, 0x0),
+    makeBlock(GRASS,      {3, 15},  {8, 13},  {2, 15},  false,  false,   true,  false, 0x1),
+    makeBlock(DIRT,       {2, 15},  {2, 15},  {2, 15},  false,  false,   true,  false, 0x2),
+    makeBlock(STONE,      {1, 15},  {1, 15},  {1, 15},  false,  false,   true,  false, 0x3),
+    makeBlock(WATER,      {14, 3},  {14, 3},  {14, 3},  true,   true,    false, true,  0x4),
+    makeBlock(SNOW,       {2, 11},  {2, 11},  {2, 11},  false,  false,   true,  false, 0x5),
+    makeBlock(LAVA,       {13, 1},  {13, 1},  {13, 1},  false,  true,    false, true,  0x6),
+    makeBlock(BEDROCK,    {1, 14},  {1, 14},  {1, 14},  false,  false,   true,  false, 0x7),
+    makeBlock(GLASS,      {1, 12},  {1, 12},  {1, 12},  true,   false,   true,  false, 0x8),
+    makeBlock(OAK_LOG,    {4, 14},  {5, 14},  {5, 14},  false,  false,   true,  false, 0x9),
+    makeBlock(OAK_LEAVES, {4, 12},  {4, 12},  {4, 12},  true,   false,   true,  false, 0xA),
+    makeBlock(OBSIDIAN,   {7, 4},   {7, 4},   {7, 4},   false,  false,   true,  false, 0xB),
+    makeBlock(BONE,       {15, 4},  {15, 4},  {15, 4},  false,  false,   true,  false, 0xC),
+}};
+
+constexpr bool registryInEnumOrder()
+{
+    for (int i = 0; i < BLOCK_TYPE_COUNT; i++)
+    {
+        if (block_registry[i].type != i)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(registryInEnumOrder(), "block_registry must list every BlockType in enum order");
+
+constexpr const BlockProperties& blockProperties(BlockType t)
+{
+    return block_registry[t];
+}
+
+// The inverse of BlockProperties::saveId, built at compile time.
+// Bytes that no block type is saved as map to BLOCK_TYPE_COUNT.
+struct SaveIdTable
+{
+    std::array<unsigned char, 256> types;
+
+    constexpr SaveIdTable() : types{}
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            types[i] = BLOCK_TYPE_COUNT;
+        }
+        for (int t = 0; t < BLOCK_TYPE_COUNT; t++)
+        {
+            types[block_registry[t].saveId] = t;
+        }
+    }
+};
+
+constexpr SaveIdTable save_id_table{};
+
+constexpr bool saveIdsUnique()
+{
+    for (int t = 0; t < BLOCK_TYPE_COUNT; t++)
+    {
+        if (save_id_table.types[block_registry[t].saveId] != t)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(saveIdsUnique(), "two block types share a saveId");
+
+// Throws std::out_of_range for a byte that is not any block's saveId
+inline BlockType blockFromSaveId(unsigned char id)
+{
+    if (save_id_table.types[id] == BLOCK_TYPE_COUNT)
+    {
+        throw std::out_of_range("unknown block save id " + std::to_string(id));
+    }
+    return static_cast<BlockType>(save_id_table.types[id]);
+}
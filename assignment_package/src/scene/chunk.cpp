@@ -1,59 +1,285 @@
 #include "chunk.h"
+#include "meshbufferpool.h"
+#include "generationpipeline.h"
+#include <algorithm>
 #include <iostream>
 #include <ostream>
 #include <QFile>
+#include <stdexcept>
 #include <string>
 
+// The bitmask mesher has an AVX2 path, picked at run time on CPUs that support it
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define BITMASK_AVX2
+#include <immintrin.h>
+#endif
+
 DrawableChunk::DrawableChunk(OpenGLContext *mp_context)
-    : Drawable(mp_context), ptrsValid(false), vbo(nullptr), idx(nullptr), count(nullptr) {
+    : Drawable(mp_context), m_slots{} {
 
 }
 
 void DrawableChunk::createVBOdata() {
-    if (!ptrsValid) {
-        throw std::out_of_range("attempting to draw chunk with possibly invalid pointers");
-    }
+    // Chunk meshes are made on the worker threads and sent up with create()
+    throw std::out_of_range("chunks are only created from ChunkVBOData");
+}
 
-    // At this point, VBO contains data of the entire chunk
-    m_count = idx->size();
+void DrawableChunk::create(std::vector<ChunkVertex>& vbo, std::vector<GLuint>& idx, const std::array<MeshSlot, 16> &sectionSlots)
+{
+    // Every slot is drawn in full, padding included
+    m_count = idx.size();
+    m_slots = sectionSlots;
 
     generateIdx();
     mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx->size() * sizeof(GLuint), idx->data(), GL_STATIC_DRAW);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
 
     generateInterleaved();
     mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufInterleaved);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, vbo->size() * sizeof(glm::vec4), vbo->data(), GL_STATIC_DRAW);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, vbo.size() * sizeof(ChunkVertex), vbo.data(), GL_STATIC_DRAW);
+}
 
-    ptrsValid = false;
+bool DrawableChunk::sectionFits(int section, size_t vertices) const
+{
+    // A slot always has 6 indices for every 4 vertices of capacity
+    return vertices <= m_slots[section].vertexCapacity;
 }
 
-void DrawableChunk::create(std::vector<glm::vec4>& vbo, std::vector<GLuint>& idx)
+void DrawableChunk::updateSection(int section, std::vector<ChunkVertex>& vbo, std::vector<GLuint>& idx)
 {
-    //    if (!ptrsValid) {
-    //        throw std::out_of_range("attempting to draw chunk with possibly invalid pointers");
-    //    }
+    const MeshSlot &slot = m_slots[section];
+    for (GLuint &i : idx)
+    {
+        i += slot.firstVertex;
+    }
+    // Overwrite the rest of the slot's old triangles with degenerate ones
+    idx.resize(slot.indexCapacity, slot.firstVertex);
 
-    generateIdx();
+    // Vertices past the new ones are left in place, since no index refers to them any more
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufInterleaved);
+    mp_context->glBufferSubData(GL_ARRAY_BUFFER, slot.firstVertex * sizeof(ChunkVertex),
+                                vbo.size() * sizeof(ChunkVertex), vbo.data());
     mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+    mp_context->glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, slot.firstIndex * sizeof(GLuint),
+                                idx.size() * sizeof(GLuint), idx.data());
+}
 
-    generateInterleaved();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufInterleaved);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, vbo.size() * sizeof(glm::vec4), vbo.data(), GL_STATIC_DRAW);
+BlockSection::BlockSection() : m_palette{EMPTY}, m_data(), m_bits(0)
+{}
 
-    ptrsValid = false;
+unsigned int BlockSection::getIndex(unsigned int i) const {
+    unsigned int bit = i * m_bits;
+    return (m_data[bit >> 6] >> (bit & 63)) & ((1u << m_bits) - 1);
 }
 
-Chunk::Chunk(OpenGLContext *mp_context, int x, int z, int64_t key) : m_blocks(), minX(x), minZ(z), key(key), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
-    cData(this), generated(false), trees(), opaque(mp_context), transparent(mp_context)
-{
-    std::fill_n(m_blocks.begin(), 65536, EMPTY);
+void BlockSection::setIndex(unsigned int i, unsigned int paletteIdx) {
+    unsigned int bit = i * m_bits;
+    uint64_t mask = static_cast<uint64_t>((1u << m_bits) - 1) << (bit & 63);
+    uint64_t &word = m_data[bit >> 6];
+    word = (word & ~mask) | (static_cast<uint64_t>(paletteIdx) << (bit & 63));
+}
+
+void BlockSection::resize(unsigned int bits) {
+    std::vector<uint64_t> oldData = std::move(m_data);
+    unsigned int oldBits = m_bits;
+
+    m_bits = bits;
+    m_data.assign(bits == 0 ? 0 : 4096 * bits / 64, 0);
+    if (bits == 0 || oldBits == 0) {
+        // Going from uniform, every index is already 0 (the one palette entry)
+        return;
+    }
+    for (unsigned int i = 0; i < 4096; i++) {
+        unsigned int bit = i * oldBits;
+        setIndex(i, (oldData[bit >> 6] >> (bit & 63)) & ((1u << oldBits) - 1));
+    }
+}
+
+BlockType BlockSection::get(unsigned int i) const {
+    if (m_bits == 0) {
+        return m_palette[0];
+    }
+    return m_palette[getIndex(i)];
+}
+
+void BlockSection::set(unsigned int i, BlockType t) {
+    if (m_bits == 0 && m_palette[0] == t) {
+        return;
+    }
+
+    unsigned int paletteIdx = 0;
+    while (paletteIdx < m_palette.size() && m_palette[paletteIdx] != t) {
+        paletteIdx++;
+    }
+    if (paletteIdx == m_palette.size()) {
+        m_palette.push_back(t);
+        // Widen the indices to the next power of two bit count when the palette outgrows them
+        unsigned int bits = (m_bits == 0) ? 1 : m_bits;
+        while (m_palette.size() > (1u << bits)) {
+            bits *= 2;
+        }
+        if (bits != m_bits) {
+            resize(bits);
+        }
+    }
+    setIndex(i, paletteIdx);
+}
+
+void BlockSection::compact() {
+    if (m_bits == 0) {
+        return;
+    }
+
+    std::array<unsigned int, 256> counts{};
+    for (unsigned int i = 0; i < 4096; i++) {
+        counts[getIndex(i)]++;
+    }
+
+    // Build the new palette from only the entries still in use
+    std::array<unsigned int, 256> remap{};
+    std::vector<BlockType> palette;
+    for (unsigned int p = 0; p < m_palette.size(); p++) {
+        if (counts[p] > 0) {
+            remap[p] = palette.size();
+            palette.push_back(m_palette[p]);
+        }
+    }
+
+    if (palette.size() == 1) {
+        m_palette = std::move(palette);
+        m_data.clear();
+        m_data.shrink_to_fit();
+        m_bits = 0;
+        return;
+    }
+
+    unsigned int bits = 1;
+    while (palette.size() > (1u << bits)) {
+        bits *= 2;
+    }
+    if (palette.size() == m_palette.size() && bits == m_bits) {
+        return;
+    }
+
+    std::array<unsigned char, 4096> indices;
+    for (unsigned int i = 0; i < 4096; i++) {
+        indices[i] = remap[getIndex(i)];
+    }
+    m_palette = std::move(palette);
+    m_bits = bits;
+    m_data.assign(4096 * bits / 64, 0);
+    m_data.shrink_to_fit();
+    for (unsigned int i = 0; i < 4096; i++) {
+        setIndex(i, indices[i]);
+    }
+}
+
+void BlockSection::assign(const BlockType* blocks) {
+    std::array<unsigned char, 256> paletteIdx;
+    paletteIdx.fill(0xFF);
+    m_palette.clear();
+    for (unsigned int i = 0; i < 4096; i++) {
+        if (paletteIdx[blocks[i]] == 0xFF) {
+            paletteIdx[blocks[i]] = m_palette.size();
+            m_palette.push_back(blocks[i]);
+        }
+    }
+    m_palette.shrink_to_fit();
+    if (m_palette.size() == 1) {
+        m_data.clear();
+        m_data.shrink_to_fit();
+        m_bits = 0;
+        return;
+    }
+
+    m_bits = 1;
+    while (m_palette.size() > (1u << m_bits)) {
+        m_bits *= 2;
+    }
+    m_data.assign(4096 * m_bits / 64, 0);
+    m_data.shrink_to_fit();
+    for (unsigned int i = 0; i < 4096; i++) {
+        setIndex(i, paletteIdx[blocks[i]]);
+    }
+}
+
+bool BlockSection::isUniform() const {
+    return m_bits == 0;
 }
 
-// Does bounds checking with at()
+size_t BlockSection::residentBytes() const {
+    return sizeof(BlockSection) + m_palette.capacity() * sizeof(BlockType) + m_data.capacity() * sizeof(uint64_t);
+}
+
+ColdBlocks::ColdBlocks() : m_palette(), m_runs(), m_columnStart()
+{}
+
+ColdBlocks::ColdBlocks(const std::array<BlockSection, 16> &sections) : ColdBlocks() {
+    // Palette index of each block type, or 0xFF until it is first seen
+    std::array<unsigned char, 256> paletteIdx;
+    paletteIdx.fill(0xFF);
+    for (unsigned int column = 0; column < 256; column++) {
+        m_columnStart[column] = m_runs.size() / 2;
+        unsigned int xz = (column & 15) + 256 * (column >> 4);
+        BlockType runType = sections[0].get(xz);
+        unsigned int runLength = 0;
+        for (unsigned int y = 0; y <= 256; y++) {
+            BlockType t = (y < 256) ? sections[y >> 4].get(xz + 16 * (y & 15)) : runType;
+            if (y < 256 && t == runType) {
+                runLength++;
+                continue;
+            }
+            if (paletteIdx[runType] == 0xFF) {
+                paletteIdx[runType] = m_palette.size();
+                m_palette.push_back(runType);
+            }
+            m_runs.push_back(paletteIdx[runType]);
+            m_runs.push_back(runLength - 1);
+            runType = t;
+            runLength = 1;
+        }
+    }
+    m_palette.shrink_to_fit();
+    m_runs.shrink_to_fit();
+}
+
+BlockType ColdBlocks::get(unsigned int x, unsigned int y, unsigned int z) const {
+    // Columns always cover all 256 heights, so this stops inside the column
+    unsigned int i = 2 * m_columnStart[x + 16 * z];
+    unsigned int top = m_runs[i + 1];
+    while (top < y) {
+        i += 2;
+        top += m_runs[i + 1] + 1;
+    }
+    return m_palette[m_runs[i]];
+}
+
+void ColdBlocks::getColumn(unsigned int x, unsigned int z, BlockType* out) const {
+    unsigned int i = 2 * m_columnStart[x + 16 * z];
+    for (unsigned int y = 0; y < 256; i += 2) {
+        unsigned int end = y + m_runs[i + 1] + 1;
+        std::fill(out + y, out + end, m_palette[m_runs[i]]);
+        y = end;
+    }
+}
+
+size_t ColdBlocks::residentBytes() const {
+    return sizeof(ColdBlocks) + m_palette.capacity() * sizeof(BlockType) + m_runs.capacity();
+}
+
+Chunk::Chunk(OpenGLContext *mp_context, int x, int z, int64_t key) : m_sections(), minX(x), minZ(z), key(key), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
+    cData(this, 0), trees(), m_state(ALLOCATED), biome(GRASSLANDS), epoch(0), sectionVersions{}, meshVersions{}, m_cold(), blockVersion(0), compressRequested(false), queuedJobs(0), m_heightmaps(), opaque(mp_context), transparent(mp_context)
+{}
+
+// Does bounds checking like at() did on the old flat block array
 BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
-    return m_blocks.at(x + 16 * y + 16 * 256 * z);
+    if (x >= 16 || y >= 256 || z >= 16) {
+        throw std::out_of_range("block index out of chunk bounds");
+    }
+    if (m_cold != nullptr) {
+        return m_cold->get(x, y, z);
+    }
+    return m_sections[y >> 4].get(x + 16 * (y & 15) + 256 * z);
 }
 
 // Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
@@ -61,9 +287,84 @@ BlockType Chunk::getBlockAt(int x, int y, int z) const {
     return getBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
 }
 
-// Does bounds checking with at()
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    std::lock_guard<std::mutex> lock(blockMutex);
+    if (m_cold != nullptr) {
+        thawLocked();
+    }
+    blockVersion++;
+    writeBlock(x, y, z, t);
+    updateColumnHeights(x, y, z, t);
+}
+
+void Chunk::writeBlock(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
+    if (x >= 16 || y >= 256 || z >= 16) {
+        throw std::out_of_range("block index out of chunk bounds");
+    }
+    m_sections[y >> 4].set(x + 16 * (y & 15) + 256 * z, t);
+}
+
+// Whether a block of type t can be the top of a column for the given heightmap
+static bool countsForHeightmap(HeightmapType type, BlockType t) {
+    return type == TOP_OPAQUE ? !blockProperties(t).transparent : t != EMPTY;
+}
+
+int Chunk::scanColumn(HeightmapType type, unsigned int x, int y, unsigned int z) const {
+    while (y >= 0) {
+        const BlockSection &s = m_sections[y >> 4];
+        // Skip the rest of a section made entirely of blocks that do not count
+        if (s.isUniform() && !countsForHeightmap(type, s.get(0))) {
+            y = (y & ~15) - 1;
+            continue;
+        }
+        if (countsForHeightmap(type, s.get(x + 16 * (y & 15) + 256 * z))) {
+            return y;
+        }
+        y--;
+    }
+    return -1;
+}
+
+void Chunk::rebuildColumnHeights(unsigned int x, unsigned int z) {
+    for (HeightmapType type : {TOP_OPAQUE, TOP_NON_AIR}) {
+        m_heightmaps[type][x + 16 * z] = scanColumn(type, x, 255, z);
+    }
+}
+
+void Chunk::updateColumnHeights(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
+    for (HeightmapType type : {TOP_OPAQUE, TOP_NON_AIR}) {
+        int16_t &top = m_heightmaps[type][x + 16 * z];
+        if (countsForHeightmap(type, t)) {
+            top = std::max<int16_t>(top, y);
+        } else if (static_cast<int>(y) == top) {
+            top = scanColumn(type, x, y - 1, z);
+        }
+    }
+}
+
+int Chunk::getHeightAt(HeightmapType type, unsigned int x, unsigned int z) const {
+    if (x >= 16 || z >= 16) {
+        throw std::out_of_range("column index out of chunk bounds");
+    }
+    return m_heightmaps[type][x + 16 * z];
+}
+
+const std::array<int16_t, 256>& Chunk::getHeightmap(HeightmapType type) const {
+    return m_heightmaps[type];
+}
+
+void Chunk::compactBlocks() {
+    for (BlockSection &s : m_sections) {
+        s.compact();
+    }
+}
+
+size_t Chunk::blockBytes() const {
+    size_t bytes = coldBytes();
+    for (const BlockSection &s : m_sections) {
+        bytes += s.residentBytes();
+    }
+    return bytes;
 }
 
 const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirection {
@@ -75,24 +376,10 @@ const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirectio
     {ZNEG, ZPOS}
 };
 
-Direction vectorToDirection (glm::vec3 v) {
-    if (v.x == 1) {
-        return XPOS;
-    }
-    if (v.x == -1) {
-        return XNEG;
-    }
-    if (v.y == 1) {
-        return YPOS;
-    }
-    if (v.y == -1) {
-        return YNEG;
-    }
-    if (v.z == 1) {
-        return ZPOS;
-    }
-    return ZNEG;
-}
+// The Direction each of neighboring_faces points in, in the same order
+const static std::array<Direction, 6> face_directions {
+    XNEG, XPOS, YNEG, YPOS, ZNEG, ZPOS
+};
 
 // Array containing data for adjacent block faces for a block
 // in the form {direction, [pos_array], [nor_array]} for each neighbor
@@ -142,200 +429,651 @@ const static std::array<glm::vec2, 4> uv_offsets {
 
 void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
     if(neighbor != nullptr) {
-        this->m_neighbors[dir] = neighbor.get();
+        {
+            std::lock_guard<std::mutex> lock(blockMutex);
+            this->m_neighbors[dir] = neighbor.get();
+        }
+        std::lock_guard<std::mutex> lock(neighbor->blockMutex);
         neighbor->m_neighbors[oppositeDirection.at(dir)] = this;
     }
 }
 
-void Chunk::makeDrawableVBOs(std::vector<glm::vec4>& vboOpaque, std::vector<GLuint> &idxOpaque,
-                             std::vector<glm::vec4>& vboTransparent, std::vector<GLuint> &idxTransparent)
+void Chunk::unlinkNeighbors() {
+    std::unordered_map<Direction, Chunk*, EnumHash> neighbors;
+    {
+        std::lock_guard<std::mutex> lock(blockMutex);
+        neighbors = m_neighbors;
+        for (auto &n : m_neighbors) {
+            n.second = nullptr;
+        }
+    }
+    // One Chunk's lock at a time, like fillSnapshot
+    for (auto &n : neighbors) {
+        if (n.second != nullptr) {
+            std::lock_guard<std::mutex> lock(n.second->blockMutex);
+            n.second->m_neighbors[oppositeDirection.at(n.first)] = nullptr;
+        }
+    }
+}
+
+// The 32 extra blocks let the bitmask mesher load 32 bytes from any row
+BlockSnapshot::BlockSnapshot(int yMin, int yMax)
+    : m_yMin(yMin), m_yMax(yMax), m_blocks(18 * 18 * (yMax - yMin + 2) + 32, EMPTY)
+{}
+
+// Where each neighbor's blocks go in a snapshot: the neighbor's column at
+// src + k * step is copied to the snapshot's column at dst + k * step
+struct HaloEdge
+{
+    Direction dir;
+    glm::ivec2 src, dst, step;
+};
+
+static const std::array<HaloEdge, 4> haloEdges {{
+    {XPOS, glm::ivec2(0, 0), glm::ivec2(16, 0), glm::ivec2(0, 1)},
+    {XNEG, glm::ivec2(15, 0), glm::ivec2(-1, 0), glm::ivec2(0, 1)},
+    {ZPOS, glm::ivec2(0, 0), glm::ivec2(0, 16), glm::ivec2(1, 0)},
+    {ZNEG, glm::ivec2(0, 15), glm::ivec2(0, -1), glm::ivec2(1, 0)}
+}};
+
+void Chunk::fillSnapshot(BlockSnapshot &snap) const
+{
+    std::array<const Chunk*, 4> neighbors;
+    {
+        std::lock_guard<std::mutex> lock(blockMutex);
+        // The rows just below and above the range come from this Chunk too,
+        // unless they are outside the world
+        for (int y = std::max(snap.m_yMin - 1, 0); y < std::min(snap.m_yMax + 1, 256); y++)
+        {
+            for (int z = 0; z < 16; z++)
+            {
+                for (int x = 0; x < 16; x++)
+                {
+                    snap.m_blocks[snap.index(x, y, z)] = m_cold != nullptr ? m_cold->get(x, y, z) :
+                                                         m_sections[y >> 4].get(x + 16 * (y & 15) + 256 * z);
+                }
+            }
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            neighbors[i] = m_neighbors.at(haloEdges[i].dir);
+        }
+    }
+
+    // Only one Chunk is locked at a time, so two snapshots can never deadlock
+    for (int i = 0; i < 4; i++)
+    {
+        if (neighbors[i] == nullptr)
+        {
+            continue;
+        }
+        const HaloEdge &e = haloEdges[i];
+        std::lock_guard<std::mutex> lock(neighbors[i]->blockMutex);
+        for (int y = snap.m_yMin; y < snap.m_yMax; y++)
+        {
+            for (int k = 0; k < 16; k++)
+            {
+                glm::ivec2 src = e.src + k * e.step, dst = e.dst + k * e.step;
+                snap.m_blocks[snap.index(dst.x, y, dst.y)] = neighbors[i]->getBlockAt(src.x, y, src.y);
+            }
+        }
+    }
+}
+
+// Which block-space axes (0 = x, 1 = y, 2 = z) the U and V texture
+// coordinates of each face in neighboring_faces run along
+const static std::array<glm::ivec2, 6> face_uv_axes {
+    glm::ivec2(2, 1), glm::ivec2(2, 1), glm::ivec2(0, 2),
+    glm::ivec2(0, 2), glm::ivec2(0, 1), glm::ivec2(0, 1)
+};
+
+std::atomic<MeshingMode> Chunk::meshingMode(NAIVE_MESHING);
+MeshBufferPool Chunk::bufferPool;
+
+// Appends a quad for face f of a block to the given buffers.
+// origin is the chunk-space minimum corner of the quad and extent is how many
+// blocks it covers along each axis (1 along the face's normal). The UVs are
+// given in blocks rather than atlas units, along with the index of the block's
+// atlas tile, so that the shader can repeat the texture across merged quads.
+static void appendFace(std::vector<ChunkVertex> &vbo, std::vector<GLuint> &idx,
+                       int f, const BlockProperties &block,
+                       glm::ivec3 origin, glm::ivec3 extent, glm::ivec2 uvExtent)
+{
+    const BlockFace &n = neighboring_faces[f];
+    GLuint first = vbo.size();
+    BlockTile tile = block.tiles[face_directions[f]];
+    unsigned int tileIdx = tile.col + 16 * tile.row;
+    unsigned int animated = block.animated ? 1 : 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        glm::ivec3 pos = origin + glm::ivec3(n.pos[i]) * extent;
+        glm::ivec2 uv = glm::ivec2(uv_offsets[i]) * uvExtent;
+        vbo.push_back(ChunkVertex(pos.x | (pos.y << 5) | (pos.z << 14) | (f << 19) | (animated << 22),
+                                  tileIdx | (uv.x << 8) | (uv.y << 17)));
+    }
+
+    // Triangulate the index buffer
+    for (GLuint i = first + 1; i < first + 3; i++)
+    {
+        idx.push_back(first);
+        idx.push_back(i);
+        idx.push_back(i + 1);
+    }
+}
+
+void Chunk::makeDrawableVBOs(std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint> &idxOpaque,
+                             std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint> &idxTransparent)
 {
-    unsigned int v_countOpaque = -1; // A counter to keep track of how many vertices actually exist. It is the index of the last vertex.
-    unsigned int v_countTransparent = -1;
+    BlockSnapshot snap(0, 256);
+    fillSnapshot(snap);
+    for (int section = 0; section < 16; section++)
+    {
+        makeSectionVBOs(snap, section, vboOpaque, idxOpaque, vboTransparent, idxTransparent);
+    }
+}
 
+void Chunk::makeSectionVBOs(const BlockSnapshot &snap, int section,
+                            std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint> &idxOpaque,
+                            std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint> &idxTransparent)
+{
+    switch (meshingMode.load()) {
+    case GREEDY_MESHING:
+        makeGreedyVBOs(snap, section, vboOpaque, idxOpaque, vboTransparent, idxTransparent);
+        break;
+    case BITMASK_MESHING:
+        makeBitmaskVBOs(snap, section, vboOpaque, idxOpaque, vboTransparent, idxTransparent);
+        break;
+    default:
+        makeNaiveVBOs(snap, section, vboOpaque, idxOpaque, vboTransparent, idxTransparent);
+        break;
+    }
+}
+
+void Chunk::makeNaiveVBOs(const BlockSnapshot &snap, int section,
+                          std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint> &idxOpaque,
+                          std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint> &idxTransparent)
+{
     for (int z = 0; z < 16; z++)
     {
-        for (int y = 0; y < 256; y++)
+        for (int y = 16 * section; y < 16 * (section + 1); y++)
         {
             for (int x = 0; x < 16; x++)
             {
-                BlockType type = getBlockAt(x,y,z);
+                BlockType type = snap.at(x, y, z);
                 // We only want to draw non-empty blocks
                 if (type != EMPTY)
                 {
+                    const BlockProperties &block = blockProperties(type);
 
-                    BlockInfo info = block_info_map.at(type);
-
-                    std::vector<glm::vec4>& vbo = (info.transparent) ? vboTransparent : vboOpaque;
-                    std::vector<GLuint>& idx = (info.transparent) ? idxTransparent : idxOpaque;
-                    unsigned int& v_count = (info.transparent) ? v_countTransparent : v_countOpaque;
+                    std::vector<ChunkVertex>& vbo = (block.transparent) ? vboTransparent : vboOpaque;
+                    std::vector<GLuint>& idx = (block.transparent) ? idxTransparent : idxOpaque;
 
                     // Iterate over the neighbors of this block
-                    for (auto &n : neighboring_faces)
+                    for (int f = 0; f < 6; f++)
                     {
-                        BlockType neighbor;
-                        getNeighbor(x, y, z, n, neighbor);
+                        glm::ivec3 d(neighboring_faces[f].direction);
+                        BlockType neighbor = snap.at(x + d.x, y + d.y, z + d.z);
                         // Only need to draw if neighbor is transparent
-                        if (block_info_map.at(neighbor).transparent && neighbor != type)
+                        if (blockProperties(neighbor).transparent && neighbor != type)
                         {
-                            // First position, then normal, then UV
-                            for (int i = 0; i < 4; i++)
-                            {
-                                // pos nor uv animated
-
-                                vbo.push_back(glm::vec4(x + minX, y, z + minZ, 0) + n.pos[i]);
-                                glm::vec4 nor = n.nor[i];
-                                vbo.push_back(nor);
-                                glm::vec2 uv = info.uv_map.at(vectorToDirection(n.direction));
-                                uv += uv_offsets[i];
-                                uv /= 16.0f;
-                                vbo.push_back(glm::vec4(uv,info.animated,-1));
-                                v_count++;
-                            }
+                            appendFace(vbo, idx, f, block, glm::ivec3(x, y, z),
+                                       glm::ivec3(1), glm::ivec2(1));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Greedy meshing: for each face direction, walk the section one slice at a time
+// along the face's normal, build a 2D mask of which block type's face is visible
+// in each cell of the slice, then cover the mask with as few rectangles as
+// possible by growing each one as wide and then as tall as the block type allows.
+// Quads never cross into the next section, so that sections can be re-meshed alone.
+void Chunk::makeGreedyVBOs(const BlockSnapshot &snap, int section,
+                           std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint> &idxOpaque,
+                           std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint> &idxTransparent)
+{
+    const glm::ivec3 size(16, 16, 16);
+    const glm::ivec3 base(0, 16 * section, 0);
+    std::vector<BlockType> mask;
 
-                            // Triangulate the index buffer
-                            for (int i = v_count - 2; i < v_count; i++)
+    for (int f = 0; f < 6; f++)
+    {
+        const BlockFace &n = neighboring_faces[f];
+        glm::ivec3 d(n.direction);
+        int normalAxis = (n.direction.x != 0) ? 0 : (n.direction.y != 0) ? 1 : 2;
+        int uAxis = face_uv_axes[f].x, vAxis = face_uv_axes[f].y;
+        int uSize = size[uAxis], vSize = size[vAxis];
+        mask.assign(uSize * vSize, EMPTY);
+
+        for (int slice = 0; slice < size[normalAxis]; slice++)
+        {
+            // Record the type of every block in this slice whose face is visible
+            for (int v = 0; v < vSize; v++)
+            {
+                for (int u = 0; u < uSize; u++)
+                {
+                    glm::ivec3 p;
+                    p[normalAxis] = slice; p[uAxis] = u; p[vAxis] = v;
+                    p += base;
+                    BlockType type = snap.at(p.x, p.y, p.z);
+                    BlockType face = EMPTY;
+                    if (type != EMPTY)
+                    {
+                        BlockType neighbor = snap.at(p.x + d.x, p.y + d.y, p.z + d.z);
+                        if (blockProperties(neighbor).transparent && neighbor != type)
+                        {
+                            face = type;
+                        }
+                    }
+                    mask[u + uSize * v] = face;
+                }
+            }
+
+            // Merge runs of the same block type into rectangles
+            for (int v = 0; v < vSize; v++)
+            {
+                for (int u = 0; u < uSize;)
+                {
+                    BlockType type = mask[u + uSize * v];
+                    if (type == EMPTY)
+                    {
+                        u++;
+                        continue;
+                    }
+
+                    int w = 1;
+                    while (u + w < uSize && mask[u + w + uSize * v] == type)
+                    {
+                        w++;
+                    }
+                    int h = 1;
+                    bool canGrow = true;
+                    while (v + h < vSize && canGrow)
+                    {
+                        for (int k = 0; k < w; k++)
+                        {
+                            if (mask[u + k + uSize * (v + h)] != type)
                             {
-                                idx.push_back(v_count-3);
-                                idx.push_back(i);
-                                idx.push_back(i+1);
+                                canGrow = false;
+                                break;
                             }
                         }
+                        if (canGrow)
+                        {
+                            h++;
+                        }
+                    }
+                    for (int dv = 0; dv < h; dv++)
+                    {
+                        std::fill_n(mask.begin() + u + uSize * (v + dv), w, EMPTY);
                     }
+
+                    const BlockProperties &block = blockProperties(type);
+                    glm::ivec3 p;
+                    p[normalAxis] = slice; p[uAxis] = u; p[vAxis] = v;
+                    p += base;
+                    glm::ivec3 extent(1);
+                    extent[uAxis] = w; extent[vAxis] = h;
+                    appendFace(block.transparent ? vboTransparent : vboOpaque,
+                               block.transparent ? idxTransparent : idxOpaque,
+                               f, block, p, extent, glm::ivec2(w, h));
+                    u += w;
                 }
             }
         }
     }
+}
+
+// The bitmask mesher works on rows of 18 blocks along x (the section's 16
+// plus the snapshot's border), each stored as an 18 bit mask with x in bit
+// x + 1, for every y and z of a section and its one block border.
+// A block's face is visible when the block next to it is see-through and of a
+// different type, so for opaque blocks the visible faces are
+// opaque & (see-through shifted by one block), and for each see-through type
+// they are type & ((see-through & ~type) shifted by one block).
+// Shifting along x is a bit shift, along y and z it is a different row.
+#define MASK_ROWS (18 * 18)
+// Bits for x in [0, 16), leaving out the border
+#define MASK_INNER 0x1FFFEu
+
+// The see-through block types other than EMPTY, which the bitmask mesher
+// keeps a mask of each, listed once from the block registry
+struct BitmaskTables
+{
+    std::vector<BlockType> seeThroughTypes;
 
-    this->opaque.m_count = idxOpaque.size();
-    this->transparent.m_count = idxTransparent.size();
+    BitmaskTables() : seeThroughTypes()
+    {
+        for (const BlockProperties &b : block_registry)
+        {
+            if (b.transparent && b.type != EMPTY)
+            {
+                seeThroughTypes.push_back(b.type);
+            }
+        }
+    }
+};
+
+static const BitmaskTables& bitmaskTables()
+{
+    static const BitmaskTables tables;
+    return tables;
 }
 
-void Chunk::resetVBOData() {
-    destroyVBOData();
+// Builds the see-through mask and one mask per see-through type for the
+// 18 rows starting at row; typeMasks[k] is for tables.seeThroughTypes[k]
+static void buildRowMasks(const BlockType* row, const BitmaskTables &tables,
+                          uint32_t &seeThrough, uint32_t* typeMasks)
+{
+    seeThrough = 0;
+    for (size_t k = 0; k < tables.seeThroughTypes.size(); k++)
+    {
+        typeMasks[k] = 0;
+    }
+    for (int i = 0; i < 18; i++)
+    {
+        if (blockProperties(row[i]).transparent)
+        {
+            seeThrough |= 1u << i;
+            for (size_t k = 0; k < tables.seeThroughTypes.size(); k++)
+            {
+                typeMasks[k] |= static_cast<uint32_t>(row[i] == tables.seeThroughTypes[k]) << i;
+            }
+        }
+    }
+}
 
-    std::vector<glm::vec4> vboOpaque;
-    std::vector<GLuint> idxOpaque;
-    std::vector<glm::vec4> vboTransparent;
-    std::vector<GLuint> idxTransparent;
-    makeDrawableVBOs(vboOpaque, idxOpaque, vboTransparent, idxTransparent);
-    create(vboOpaque,idxOpaque,vboTransparent,idxTransparent);
+// For 16 rows of blocks (z = 0 to 15 at one height), writes the mask of visible
+// faces in each direction given the blocks' own mask and the mask of blocks
+// they can be seen through. Rows for z are consecutive and rows for y are 18 apart.
+static void visibleFaces(const uint32_t* self, const uint32_t* see, std::array<std::array<uint32_t, 16>, 6> &out)
+{
+    for (int z = 0; z < 16; z++)
+    {
+        uint32_t s = self[z];
+        out[0][z] = s & (see[z] << 1);
+        out[1][z] = s & (see[z] >> 1);
+        out[2][z] = s & see[z - 18];
+        out[3][z] = s & see[z + 18];
+        out[4][z] = s & see[z - 1];
+        out[5][z] = s & see[z + 1];
+    }
+}
 
+static int lowestBit(uint32_t bits)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(bits);
+#else
+    int i = 0;
+    while ((bits & 1) == 0)
+    {
+        bits >>= 1;
+        i++;
+    }
+    return i;
+#endif
 }
 
-// Helper function for obtaining the neighbor at position (x, y, z) in local chunk space
-void Chunk::getNeighbor(int x, int y, int z, const BlockFace &n, BlockType &neighbor)
+#ifdef BITMASK_AVX2
+// The same as visibleFaces, eight rows at a time
+__attribute__((target("avx2")))
+static void visibleFacesAVX2(const uint32_t* self, const uint32_t* see, std::array<std::array<uint32_t, 16>, 6> &out)
 {
-    if (x == 0 && n.direction.x == -1)
+    for (int z = 0; z < 16; z += 8)
     {
-        neighbor = (m_neighbors[XNEG] != nullptr) ? m_neighbors[XNEG]->getBlockAt(15, y, z) : EMPTY;
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(self + z));
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(see + z));
+        __m256i yNeg = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(see + z - 18));
+        __m256i yPos = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(see + z + 18));
+        __m256i zNeg = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(see + z - 1));
+        __m256i zPos = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(see + z + 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[0][z]), _mm256_and_si256(s, _mm256_slli_epi32(x, 1)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[1][z]), _mm256_and_si256(s, _mm256_srli_epi32(x, 1)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[2][z]), _mm256_and_si256(s, yNeg));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[3][z]), _mm256_and_si256(s, yPos));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[4][z]), _mm256_and_si256(s, zNeg));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[5][z]), _mm256_and_si256(s, zPos));
     }
-    else if (x == 15 && n.direction.x == 1)
+}
+
+// The same as buildRowMasks, comparing all 18 blocks of the row at once.
+// Reads 32 bytes from row, which BlockSnapshot leaves room for.
+__attribute__((target("avx2")))
+static void buildRowMasksAVX2(const BlockType* row, const BitmaskTables &tables,
+                              uint32_t &seeThrough, uint32_t* typeMasks)
+{
+    __m256i blocks = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(blocks, _mm256_setzero_si256())));
+    for (size_t k = 0; k < tables.seeThroughTypes.size(); k++)
     {
-        neighbor = (m_neighbors[XPOS] != nullptr) ? m_neighbors[XPOS]->getBlockAt(0, y, z) : EMPTY;
+        __m256i type = _mm256_set1_epi8(static_cast<char>(tables.seeThroughTypes[k]));
+        typeMasks[k] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(blocks, type))) & 0x3FFFFu;
+        mask |= typeMasks[k];
     }
-    else if (z == 0 && n.direction.z == -1)
+    seeThrough = mask & 0x3FFFFu;
+}
+
+static bool hasAVX2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+void Chunk::makeBitmaskVBOs(const BlockSnapshot &snap, int section,
+                            std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint> &idxOpaque,
+                            std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint> &idxTransparent)
+{
+    const BitmaskTables &tables = bitmaskTables();
+    const size_t numTypes = tables.seeThroughTypes.size();
+#ifdef BITMASK_AVX2
+    const bool avx2 = hasAVX2();
+#endif
+    // Row (y, z) of the section and its border is at index (z + 1) + 18 * (y - yMin + 1)
+    const int yMin = 16 * section;
+    std::array<uint32_t, MASK_ROWS> seeThrough;
+    std::vector<std::array<uint32_t, MASK_ROWS>> ofType(numTypes);
+    std::vector<uint32_t> rowTypes(numTypes);
+    std::vector<char> typePresent(numTypes, false);
+    for (int y = 0; y < 18; y++)
     {
-        neighbor = (m_neighbors[ZNEG] != nullptr) ? m_neighbors[ZNEG]->getBlockAt(x, y, 15) : EMPTY;
+        for (int z = 0; z < 18; z++)
+        {
+            int r = z + 18 * y;
+            const BlockType* row = snap.row(yMin + y - 1, z - 1);
+#ifdef BITMASK_AVX2
+            if (avx2)
+            {
+                buildRowMasksAVX2(row, tables, seeThrough[r], rowTypes.data());
+            }
+            else
+#endif
+            {
+                buildRowMasks(row, tables, seeThrough[r], rowTypes.data());
+            }
+            for (size_t k = 0; k < numTypes; k++)
+            {
+                ofType[k][r] = rowTypes[k];
+                // Only blocks inside the section are meshed
+                typePresent[k] |= (y >= 1 && y <= 16 && z >= 1 && z <= 16 && (rowTypes[k] & MASK_INNER) != 0);
+            }
+        }
     }
-    else if (z == 15 && n.direction.z == 1)
+
+    std::array<uint32_t, MASK_ROWS> self, see;
+    std::array<std::array<uint32_t, 16>, 6> visible;
+    // Pass 0 meshes the opaque blocks, pass k + 1 the see-through type k
+    for (size_t pass = 0; pass <= numTypes; pass++)
     {
-        neighbor = (m_neighbors[ZPOS] != nullptr) ? m_neighbors[ZPOS]->getBlockAt(x, y, 0) : EMPTY;
+        if (pass > 0 && !typePresent[pass - 1])
+        {
+            continue;
+        }
+        for (int r = 0; r < MASK_ROWS; r++)
+        {
+            if (pass == 0)
+            {
+                self[r] = ~seeThrough[r] & MASK_INNER;
+                see[r] = seeThrough[r];
+            }
+            else
+            {
+                self[r] = ofType[pass - 1][r] & MASK_INNER;
+                see[r] = seeThrough[r] & ~ofType[pass - 1][r];
+            }
+        }
+        std::vector<ChunkVertex> &vbo = (pass == 0) ? vboOpaque : vboTransparent;
+        std::vector<GLuint> &idx = (pass == 0) ? idxOpaque : idxTransparent;
+
+        for (int y = yMin; y < yMin + 16; y++)
+        {
+            int r = 1 + 18 * (y - yMin + 1);
+#ifdef BITMASK_AVX2
+            if (avx2)
+            {
+                visibleFacesAVX2(&self[r], &see[r], visible);
+            }
+            else
+#endif
+            {
+                visibleFaces(&self[r], &see[r], visible);
+            }
+            for (int f = 0; f < 6; f++)
+            {
+                for (int z = 0; z < 16; z++)
+                {
+                    // Emit a quad for each set bit
+                    for (uint32_t bits = visible[f][z]; bits != 0; bits &= bits - 1)
+                    {
+                        int x = lowestBit(bits) - 1;
+                        BlockType type = (pass == 0) ? snap.at(x, y, z) : tables.seeThroughTypes[pass - 1];
+                        appendFace(vbo, idx, f, blockProperties(type), glm::ivec3(x, y, z),
+                                   glm::ivec3(1), glm::ivec2(1));
+                    }
+                }
+            }
+        }
     }
-    else if ((y == 0 && n.direction.y == -1) || (y == 255 && n.direction.y == 1))
+}
+
+// Gives the section that was just appended after slot's start room for
+// a quarter more quads, or 8 quads if it has few, and fills that room
+// with unused vertices and degenerate triangles
+static void padSlot(std::vector<ChunkVertex> &vbo, std::vector<GLuint> &idx, MeshSlot &slot)
+{
+    GLuint used = vbo.size() - slot.firstVertex;
+    slot.vertexCapacity = used + std::max(used / 16 * 4, GLuint(32));
+    slot.indexCapacity = slot.vertexCapacity / 4 * 6;
+    vbo.resize(slot.firstVertex + slot.vertexCapacity, ChunkVertex(0));
+    idx.resize(slot.firstIndex + slot.indexCapacity, slot.firstVertex);
+}
+
+void Chunk::makeDrawableVBOs(ChunkVBOData &data)
+{
+    // Read the versions before the blocks, so an edit made after
+    // the snapshot leaves its section marked out of date
+    for (int section = 0; section < 16; section++)
     {
-        neighbor = EMPTY;
+        data.versions[section] = getSectionVersion(section);
     }
-    else
+    BlockSnapshot snap(0, 256);
+    fillSnapshot(snap);
+
+    std::array<size_t, 4> reserved = bufferPool.acquire(data, biome);
+    for (int section = 0; section < 16; section++)
     {
-        neighbor = getBlockAt((int)(x + n.direction.x), (int)(y + n.direction.y), (int)(z + n.direction.z));
+        MeshSlot &o = data.slotsOpaque[section], &t = data.slotsTransparent[section];
+        o.firstVertex = data.vboDataOpaque.size();
+        o.firstIndex = data.idxDataOpaque.size();
+        t.firstVertex = data.vboDataTransparent.size();
+        t.firstIndex = data.idxDataTransparent.size();
+        makeSectionVBOs(snap, section, data.vboDataOpaque, data.idxDataOpaque,
+                        data.vboDataTransparent, data.idxDataTransparent);
+        padSlot(data.vboDataOpaque, data.idxDataOpaque, o);
+        padSlot(data.vboDataTransparent, data.idxDataTransparent, t);
     }
+    bufferPool.recordMesh(data, biome, reserved);
+}
+
+void Chunk::makeSectionVBOs(ChunkVBOData &data, int section)
+{
+    data.section = section;
+    data.versions[section] = getSectionVersion(section);
+    BlockSnapshot snap(16 * section, 16 * (section + 1));
+    fillSnapshot(snap);
+
+    // Sections are not fed back into the expected sizes, which are per Chunk
+    bufferPool.acquire(data, biome, 1.f / 16);
+    makeSectionVBOs(snap, section, data.vboDataOpaque, data.idxDataOpaque,
+                    data.vboDataTransparent, data.idxDataTransparent);
+}
+
+void Chunk::releaseVBOData(ChunkVBOData &data) {
+    bufferPool.release(data);
 }
 
-glm::ivec2 Chunk::getMinPos() {
+MeshBufferPool& Chunk::getBufferPool() {
+    return bufferPool;
+}
+
+void Chunk::setMeshingMode(MeshingMode mode) {
+    meshingMode.store(mode);
+}
+
+MeshingMode Chunk::getMeshingMode() {
+    return meshingMode.load();
+}
+
+void Chunk::resetVBOData() {
+    destroyVBOData();
+
+    ChunkVBOData data(this, getEpoch());
+    makeDrawableVBOs(data);
+    create(data);
+    releaseVBOData(data);
+}
+
+glm::ivec2 Chunk::getMinPos() const {
     return glm::ivec2(this->minX, this->minZ);
 }
 
-BlockType Chunk::getBlockByBiome(float height, bool onTop, BiomeType b, bool vFlip) {
-    if (height <= 128) return BlockType::STONE;
-    if (b == GRASSLANDS) {
-        return onTop ? BlockType::GRASS : BlockType::DIRT;
-    } else if (b == MOUNTAINS) {
-        //switch to snow
-        return height > 200 && onTop ? BlockType::SNOW : BlockType::STONE;
-    } else if (b == VOLCANO) {
-        return vFlip ? BlockType::LAVA : BlockType::OBSIDIAN;
-    }
-    return BlockType::EMPTY;
+BiomeType Chunk::getBiome() const {
+    return biome;
 }
 
-void Chunk::setChunkGenHeights() {
-    glm::vec2 pos = this->getMinPos();
+bool Chunk::isGenerated() const {
+    ChunkState state = m_state.load();
+    return state >= GENERATED && state <= DIRTY;
+}
+
+void Chunk::commitGeneration(const GenerationContext &ctx) {
+    // Neighbors being meshed may snapshot this Chunk at any time
+    std::lock_guard<std::mutex> lock(blockMutex);
+    for (int i = 0; i < 16; i++) {
+        m_sections[i].assign(&ctx.blocks[4096 * i]);
+    }
+    biome = ctx.columns[8 + 16 * 8].biome;
     for (int x = 0; x < 16; x++) {
         for (int z = 0; z < 16; z++) {
-            std::tuple<int, BiomeType, bool> biomeInfo = TerrainGen::getHeight(glm::vec2(pos.x + x, pos.y + z));
-            int height = std::get<0>(biomeInfo);
-            BiomeType b = std::get<1>(biomeInfo);
-            bool vFlip = std::get<2>(biomeInfo);
+            rebuildColumnHeights(x, z);
 
-            if (vFlip && b == VOLCANO) {
-                height = 130;
-            }
-
-            glm::ivec2 tempPosVec2Tree = glm::ivec2(x, z);
-            glm::ivec4 tempPosVec4Tree = glm::ivec4(pos.x + x, height, pos.y + z, 1);
-
-            if (TerrainGen::WorleyNoise3(pos.x + x, pos.y + z) > 0.96 && b == GRASSLANDS) {
+            // Trees grow from the column's generated height
+            if (ctx.treeSites[x + 16 * z]) {
+                glm::ivec2 tempPosVec2Tree = glm::ivec2(x, z);
+                glm::ivec4 tempPosVec4Tree = glm::ivec4(ctx.minPos.x + x, ctx.columns[x + 16 * z].height, ctx.minPos.y + z, 1);
                 if (treesMap.find(tempPosVec2Tree) == treesMap.end()) {
                     treesMap.insert({tempPosVec2Tree, tempPosVec4Tree});
                     trees.push_back(tempPosVec4Tree);
                 }
             }
-
-            //set blocks
-            for (int y = 1; y <= height; y++) {
-                BlockType type = getBlockByBiome(height, y == height, b, vFlip);
-                this->setBlockAt(x, y, z, type);
-                //cave range
-                if (y < 150 && y > 0) {
-                    float perlin3D = TerrainGen::perlinNoise3D(glm::vec3(pos.x + x, y, pos.y + z) / 25.f);
-
-                    // "Floor" height of terrain is about 128
-                    // Want Perlin value to increase closer to surface so caves are smaller
-                    perlin3D += pow(glm::smoothstep(100.f, 130.f, (float)y), 2) * 0.3;
-
-                    //cave limit of perlin val
-                    if (perlin3D < 0.f) {
-                        //25 -- above is empty, below is lava
-                        this->setBlockAt(x, y, z, y > 25 ? BlockType::EMPTY : BlockType::LAVA);
-                    }
-                }
-            }
-
-            //make water pools from [128, 138)
-            if (height >= 127 && this->getBlockAt(x, height, z) != BlockType::EMPTY && b != VOLCANO) {
-                if (b != VOLCANO) {
-                    for (int y = height + 1; y < 138; y++) {
-                        if (this->getBlockAt(x, y, z) == BlockType::EMPTY) {
-                            this->setBlockAt(x, y, z, BlockType::WATER);
-                        }
-                    }
-                }
-            }
-
-//            //make lava pools from (130, 160)
-//            if (height >= 110 && this->getBlockAt(x, height, z) != BlockType::EMPTY && b == VOLCANO) {
-//                for (int y = height + 1; y < 160; y++) {
-//                    if (this->getBlockAt(x, y, z) == BlockType::EMPTY) {
-//                        this->setBlockAt(x, y, z, BlockType::LAVA);
-//                    }
-//                }
-//            }
-            this->setBlockAt(x, 0, z, BlockType::BEDROCK);
         }
     }
-
-    generated.store(true);
+    setState(GENERATED);
 }
 
 bool Chunk::hasVBOData()
@@ -343,17 +1081,34 @@ bool Chunk::hasVBOData()
     return opaque.elemCount() != -1 && transparent.elemCount() != -1;
 }
 
-void Chunk::create(std::vector<glm::vec4>& vboDataOpaque, std::vector<GLuint>& idxDataOpaque,
-                   std::vector<glm::vec4>& vboDataTransparent, std::vector<GLuint>& idxDataTransparent)
+void Chunk::create(ChunkVBOData &data)
+{
+    this->opaque.create(data.vboDataOpaque, data.idxDataOpaque, data.slotsOpaque);
+    this->transparent.create(data.vboDataTransparent, data.idxDataTransparent, data.slotsTransparent);
+    meshVersions = data.versions;
+}
+
+bool Chunk::updateSection(ChunkVBOData &data)
 {
-    this->opaque.create(vboDataOpaque, idxDataOpaque);
-    this->transparent.create(vboDataTransparent, idxDataTransparent);
+    // Check both halves first so the section is never left half replaced
+    if (!opaque.sectionFits(data.section, data.vboDataOpaque.size()) ||
+        !transparent.sectionFits(data.section, data.vboDataTransparent.size()))
+    {
+        return false;
+    }
+    opaque.updateSection(data.section, data.vboDataOpaque, data.idxDataOpaque);
+    transparent.updateSection(data.section, data.vboDataTransparent, data.idxDataTransparent);
+    meshVersions[data.section] = data.versions[data.section];
+    return true;
 }
 
 void Chunk::destroyVBOData()
 {
     this->opaque.destroyVBOdata();
     this->transparent.destroyVBOdata();
+    // So that no section update is written into the deleted buffers
+    this->opaque.m_slots = {};
+    this->transparent.m_slots = {};
 }
 
 std::vector<glm::ivec4>& Chunk::getTrees() {
@@ -372,52 +1127,195 @@ int64_t Chunk::getKey() {
     return key;
 }
 
-const static std::unordered_map<BlockType,unsigned char, EnumHash> block_to_char{
-                                                                         {EMPTY,0x0},
-    {GRASS,0x1},
-    {DIRT,0x2},
-    {STONE,0x3},
-    {WATER,0x4},
-    {SNOW,0x5},
-    {LAVA,0x6},
-    {BEDROCK,0x7},
-    {GLASS,0x8},
-    {OAK_LOG, 0x9},
-    {OAK_LEAVES,0xA},
-    {OBSIDIAN,0xB},
-};
-const static std::unordered_map<unsigned char, BlockType> char_to_block{
-                                                                        {0x0,EMPTY},
-    {0x1,GRASS},
-    {0x2,DIRT},
-    {0x3,STONE},
-    {0x4,WATER},
-    {0x5,SNOW},
-    {0x6,LAVA},
-    {0x7,BEDROCK},
-    {0x8,GLASS},
-    {0x9,OAK_LOG},
-    {0xA,OAK_LEAVES},
-    {0xB,OBSIDIAN},
+unsigned int Chunk::getEpoch() const {
+    return epoch.load();
+}
+
+void Chunk::bumpEpoch() {
+    epoch++;
+    // Its mesh is being thrown away, so it will need a new one
+    ChunkState state = m_state.load();
+    while (state >= MESHING && state <= DIRTY && !m_state.compare_exchange_weak(state, GENERATED)) {}
+}
+
+// For each ChunkState, a bit for every state it may move to
+static const std::array<uint8_t, CHUNK_STATE_COUNT> allowedTransitions = {
+    // ALLOCATED: queued to be generated, or generated in place (as the benchmarks do)
+    1 << GENERATING | 1 << GENERATED | 1 << EVICTING,
+    // GENERATING: generated, or cancelled because the Chunk left CREATE_RADIUS
+    1 << GENERATED | 1 << ALLOCATED,
+    // GENERATED
+    1 << MESHING | 1 << EVICTING,
+    // MESHING, and the three below: back to GENERATED when the mesh is thrown away
+    1 << MESHED | 1 << GENERATED,
+    // MESHED: to MESHING when meshed again before the upload
+    1 << UPLOADED | 1 << DIRTY | 1 << MESHING | 1 << GENERATED,
+    // UPLOADED
+    1 << DIRTY | 1 << MESHING | 1 << GENERATED,
+    // DIRTY
+    1 << UPLOADED | 1 << MESHING | 1 << GENERATED,
+    // EVICTING
+    0,
 };
 
-void Chunk::load(QString savename) {
+static const char* stateName(ChunkState state) {
+    static const std::array<const char*, CHUNK_STATE_COUNT> names = {
+        "ALLOCATED", "GENERATING", "GENERATED", "MESHING", "MESHED", "UPLOADED", "DIRTY", "EVICTING"
+    };
+    return names[state];
+}
+
+ChunkState Chunk::getState() const {
+    return m_state.load();
+}
+
+bool Chunk::canTransition(ChunkState from, ChunkState to) {
+    return allowedTransitions[from] & (1 << to);
+}
+
+void Chunk::setState(ChunkState to) {
+    ChunkState from = m_state.load();
+    do {
+        if (!canTransition(from, to)) {
+            throw std::logic_error("Chunk at " + std::to_string(minX) + " " + std::to_string(minZ) +
+                                   " cannot go from " + stateName(from) + " to " + stateName(to));
+        }
+    } while (!m_state.compare_exchange_weak(from, to));
+}
+
+bool Chunk::tryTransition(ChunkState from, ChunkState to) {
+    if (!canTransition(from, to)) {
+        throw std::logic_error(std::string("no Chunk can go from ") + stateName(from) + " to " + stateName(to));
+    }
+    return m_state.compare_exchange_strong(from, to);
+}
+
+bool Chunk::requestRemesh() {
+    return tryTransition(UPLOADED, MESHING) || tryTransition(DIRTY, MESHING) || tryTransition(MESHED, MESHING);
+}
+
+bool Chunk::neighborsGenerated() const {
+    for (auto &n : m_neighbors) {
+        if (n.second == nullptr || !n.second->isGenerated()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Chunk::meshUpToDate() const {
+    for (int section = 0; section < 16; section++) {
+        if (meshVersions[section] != sectionVersions[section].load()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Chunk::requestCompression() {
+    return isGenerated() && m_cold == nullptr && !compressRequested.exchange(true);
+}
+
+ColdBlocks Chunk::compressBlocks(unsigned int &version) const {
+    std::lock_guard<std::mutex> lock(blockMutex);
+    version = blockVersion.load();
+    return ColdBlocks(m_sections);
+}
+
+void Chunk::cancelCompression() {
+    compressRequested.store(false);
+}
+
+bool Chunk::freeze(ColdBlocks &&cold, unsigned int version) {
+    std::lock_guard<std::mutex> lock(blockMutex);
+    compressRequested.store(false);
+    if (m_cold != nullptr || version != blockVersion.load()) {
+        return false;
+    }
+    m_cold = mkU<ColdBlocks>(std::move(cold));
+    m_sections = {};
+    return true;
+}
+
+void Chunk::thaw() {
+    std::lock_guard<std::mutex> lock(blockMutex);
+    if (m_cold != nullptr) {
+        thawLocked();
+    }
+}
+
+void Chunk::thawLocked() {
+    // Every section's blocks in BlockSection order, x + 16 * y + 256 * z
+    std::vector<BlockType> blocks(65536);
+    std::array<BlockType, 256> column;
+    for (unsigned int x = 0; x < 16; x++) {
+        for (unsigned int z = 0; z < 16; z++) {
+            m_cold->getColumn(x, z, column.data());
+            for (unsigned int y = 0; y < 256; y++) {
+                blocks[4096 * (y >> 4) + x + 16 * (y & 15) + 256 * z] = column[y];
+            }
+        }
+    }
+    for (int s = 0; s < 16; s++) {
+        m_sections[s].assign(&blocks[4096 * s]);
+    }
+    m_cold = nullptr;
+}
+
+bool Chunk::isCold() const {
+    return m_cold != nullptr;
+}
+
+size_t Chunk::coldBytes() const {
+    return (m_cold != nullptr) ? m_cold->residentBytes() : 0;
+}
+
+void Chunk::jobQueued() {
+    queuedJobs++;
+}
+
+void Chunk::jobFinished() {
+    queuedJobs--;
+}
+
+bool Chunk::hasQueuedJobs() const {
+    return queuedJobs.load() > 0;
+}
+
+unsigned int Chunk::getSectionVersion(int section) const {
+    return sectionVersions[section].load();
+}
+
+void Chunk::bumpSectionVersion(int section) {
+    sectionVersions[section]++;
+}
+
+void Chunk::load(QString savename, const TerrainGen &gen) {
     QString keyStr = std::to_string(key).c_str();
     QFile file("../saves/"+savename+"/"+keyStr+".chunk");
     file.open(QIODevice::ReadOnly);
     QDataStream in(&file);
 
+    std::lock_guard<std::mutex> lock(blockMutex);
+    // Blocks are stored in x, then y, then z order
     long i = 0;
-    while (!in.atEnd()) {
+    while (!in.atEnd() && i < 65536) {
         unsigned char byte;
         in >> byte;
-        m_blocks[i] = char_to_block.at(byte);
+        writeBlock(i % 16, (i / 16) % 256, i / 4096, blockFromSaveId(byte));
         i++;
     }
 
     file.close();
+    compactBlocks();
+    for (unsigned int x = 0; x < 16; x++) {
+        for (unsigned int z = 0; z < 16; z++) {
+            rebuildColumnHeights(x, z);
+        }
+    }
+    biome = std::get<1>(gen.getHeight(glm::vec2(minX + 8, minZ + 8)));
 
-    generated.store(true);
+    setState(GENERATED);
 }
 
 void Chunk::save(QString savename) {
@@ -426,22 +1324,16 @@ void Chunk::save(QString savename) {
     file.open(QIODevice::WriteOnly);
     QDataStream out(&file);
 
-    for (BlockType block : m_blocks) {
-        unsigned char byte = block_to_char.at(block);
-        out << byte;
-    }
-
-    file.close();
-}
-
-bool Chunk::canCreate() {
-    if (!generated.load() || hasVBOData()) return false;
-
-    for (auto n : m_neighbors) {
-        if (n.second == nullptr || !n.second->generated.load()) {
-            return false;
+    // The player may be editing this Chunk on the main thread
+    std::lock_guard<std::mutex> lock(blockMutex);
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 256; y++) {
+            for (int x = 0; x < 16; x++) {
+                unsigned char byte = blockProperties(getBlockAt(x, y, z)).saveId;
+                out << byte;
+            }
         }
     }
 
-    return true;
+    file.close();
 }
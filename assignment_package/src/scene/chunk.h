@@ -5,28 +5,17 @@
 #include <array>
 #include <unordered_map>
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 #include <atomic>
+#include <mutex>
 
 #include "terraingen.h"
+#include "blockregistry.h"
 
 
 //using namespace std;
 
-// C++ 11 allows us to define the size of an enum. This lets us use only one byte
-// of memory to store our different block types. By default, the size of a C++ enum
-// is that of an int (so, usually four bytes). This *does* limit us to only 256 different
-// block types, but in the scope of this project we'll never get anywhere near that many.
-enum BlockType : unsigned char
-{
-    EMPTY, GRASS, DIRT, STONE, WATER, SNOW, LAVA, BEDROCK, GLASS, OAK_LOG, OAK_LEAVES, OBSIDIAN, BONE
-};
-
-// The six cardinal directions in 3D space
-enum Direction : unsigned char
-{
-    XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
-};
-
 // Lets us use any enum class as the key of a
 // std::unordered_map
 struct EnumHash {
@@ -52,109 +41,49 @@ struct BlockFace
     std::array<glm::vec4, 4> nor;
 };
 
-struct BlockInfo {
-    std::unordered_map<Direction,glm::vec2,EnumHash> uv_map;
-    bool transparent;
-    float animated;
+// How Chunk::makeDrawableVBOs turns blocks into quads.
+// NAIVE_MESHING emits one quad per visible block face, while GREEDY_MESHING
+// merges neighboring coplanar faces of the same block type into larger quads.
+// BITMASK_MESHING emits the same quads as NAIVE_MESHING, but finds the visible
+// faces of a whole row of blocks at once with bit operations.
+enum MeshingMode : unsigned char
+{
+    NAIVE_MESHING, GREEDY_MESHING, BITMASK_MESHING
 };
 
-// block info is uv texture map, transparent, animated (1 or 0)
-const static std::unordered_map<BlockType, BlockInfo, EnumHash> block_info_map = {
-    {EMPTY, {{{XPOS,glm::vec2(13,2)},
-                 {XNEG,glm::vec2(13,2)},
-                 {YPOS,glm::vec2(13,2)},
-                 {YNEG,glm::vec2(13,2)},
-                 {ZPOS,glm::vec2(13,2)},
-                 {ZNEG,glm::vec2(13,2)}},
-                true, 0.0f
-            }},
-    {GRASS, {{{XPOS,glm::vec2(3,15)},
-                 {XNEG,glm::vec2(3,15)},
-                 {YPOS,glm::vec2(8,13)},
-                 {YNEG,glm::vec2(2,15)},
-                 {ZPOS,glm::vec2(3,15)},
-                 {ZNEG,glm::vec2(3,15)}},
-                false, 0.0f
-            }},
-    {DIRT, {{{XPOS,glm::vec2(2,15)},
-                {XNEG,glm::vec2(2,15)},
-                {YPOS,glm::vec2(2,15)},
-                {YNEG,glm::vec2(2,15)},
-                {ZPOS,glm::vec2(2,15)},
-                {ZNEG,glm::vec2(2,15)}},
-               false, 0.0f
-           }},
-    {STONE, {{{XPOS,glm::vec2(1,15)},
-                 {XNEG,glm::vec2(1,15)},
-                 {YPOS,glm::vec2(1,15)},
-                 {YNEG,glm::vec2(1,15)},
-                 {ZPOS,glm::vec2(1,15)},
-                 {ZNEG,glm::vec2(1,15)}},
-                false, 0.0f
-            }},
-    {WATER, {{{XPOS,glm::vec2(14,3)},
-                 {XNEG,glm::vec2(14,3)},
-                 {YPOS,glm::vec2(14,3)},
-                 {YNEG,glm::vec2(14,3)},
-                 {ZPOS,glm::vec2(14,3)},
-                 {ZNEG,glm::vec2(14,3)}},
-                true, 1.0f
-            }},
-    {SNOW, {{{XPOS,glm::vec2(2,11)},
-                {XNEG,glm::vec2(2,11)},
-                {YPOS,glm::vec2(2,11)},
-                {YNEG,glm::vec2(2,11)},
-                {ZPOS,glm::vec2(2,11)},
-                {ZNEG,glm::vec2(2,11)}},
-               false, 0.0f
-           }},
-    {LAVA, {{{XPOS,glm::vec2(13,1)},
-                {XNEG,glm::vec2(13,1)},
-                {YPOS,glm::vec2(13,1)},
-                {YNEG,glm::vec2(13,1)},
-                {ZPOS,glm::vec2(13,1)},
-                {ZNEG,glm::vec2(13,1)}},
-               false, 1.0f
-           }},
-    {BEDROCK, {{{XPOS,glm::vec2(1,14)},
-                   {XNEG,glm::vec2(1,14)},
-                   {YPOS,glm::vec2(1,14)},
-                   {YNEG,glm::vec2(1,14)},
-                   {ZPOS,glm::vec2(1,14)},
-                   {ZNEG,glm::vec2(1,14)}},
-                  false, 0.0f
-              }},
-    {GLASS, {{{XPOS,glm::vec2(1,12)},
-                 {XNEG,glm::vec2(1,12)},
-                 {YPOS,glm::vec2(1,12)},
-                 {YNEG,glm::vec2(1,12)},
-                 {ZPOS,glm::vec2(1,12)},
-                 {ZNEG,glm::vec2(1,12)}},
-                true, 0.0f
-            }},
-    {OAK_LOG, {{{XPOS,glm::vec2(4, 14)},
-                {XNEG, glm::vec2(4, 14)},
-                {YPOS, glm::vec2(5, 14)},
-                {YNEG, glm::vec2(5, 14)},
-                {ZPOS, glm::vec2(4, 14)},
-                {ZNEG, glm::vec2(4, 14)}},
-               false, 0.0f}},
-    {OAK_LEAVES, {{{XPOS,glm::vec2(4, 12)},
-                   {XNEG, glm::vec2(4, 12)},
-                   {YPOS, glm::vec2(4, 12)},
-                   {YNEG, glm::vec2(4, 12)},
-                   {ZPOS, glm::vec2(4, 12)},
-                   {ZNEG, glm::vec2(4, 12)}},
-                  true, 0.0f}},
-    {OBSIDIAN, {{{XPOS,glm::vec2(7, 4)},
-                 {XNEG, glm::vec2(7, 4)},
-                 {YPOS, glm::vec2(7, 4)},
-                 {YNEG, glm::vec2(7, 4)},
-                 {ZPOS, glm::vec2(7, 4)},
-                 {ZNEG, glm::vec2(7, 4)}},
-                false, 0.0f}},
-    {BONE, {{{XPOS,glm::vec2(15,4)}},false,0.0f}},
-    };
+// Which blocks count when finding the top of a column of blocks.
+// TOP_OPAQUE is the highest block that is not transparent,
+// TOP_NON_AIR the highest block that is not EMPTY (water and leaves included).
+enum HeightmapType : unsigned char
+{
+    TOP_OPAQUE, TOP_NON_AIR
+};
+
+// Where a Chunk is in its life. It moves forward through generation, meshing
+// and upload, and falls back to GENERATED whenever its mesh is thrown away.
+// Chunk::canTransition lists which moves are allowed.
+enum ChunkState : unsigned char
+{
+    ALLOCATED,  // Its blocks are not generated yet, or their generation was cancelled
+    GENERATING, // A GENERATE_JOB for it is queued or running
+    GENERATED,  // Its blocks are ready, and no mesh of it is queued
+    MESHING,    // A MESH_JOB for it is queued or running
+    MESHED,     // Its mesh is made and waiting to be uploaded
+    UPLOADED,   // Its uploaded mesh shows every edit made to it
+    DIRTY,      // It was edited since its mesh was uploaded, and the sections are being re-meshed
+    EVICTING    // Its zone is being unloaded, so it is about to be deleted
+};
+
+#define CHUNK_STATE_COUNT (EVICTING + 1)
+
+// A terrain vertex packed into two 32-bit words, decoded by lambert.vert.glsl.
+// Positions are stored relative to the Chunk's minimum corner, so every field
+// is a small integer:
+// word 0: x (bits 0-4), y (bits 5-13), z (bits 14-18),
+//         face index into neighboring_faces (bits 19-21), animated (bit 22)
+// word 1: atlas tile (bits 0-7), u (bits 8-16), v (bits 17-25)
+// U and V are measured in blocks so that greedy meshed quads can repeat their texture.
+typedef glm::uvec2 ChunkVertex;
 
 // One Chunk is a 16 x 256 x 16 section of the world,
 // containing all the Minecraft blocks in that area.
@@ -164,30 +93,51 @@ const static std::unordered_map<BlockType, BlockInfo, EnumHash> block_info_map =
 // to render the world block by block.
 
 class Chunk;
+class MeshBufferPool;
+struct GenerationContext;
+
+// Where the quads of one 16 block tall section of a Chunk sit in its buffers.
+// Every section is given room for more vertices than it needs so that an edit
+// can usually re-mesh it in place; the unused indices all repeat the slot's
+// first vertex, making degenerate triangles that draw nothing.
+struct MeshSlot
+{
+    GLuint firstVertex, vertexCapacity;
+    GLuint firstIndex, indexCapacity;
+};
 
 struct ChunkVBOData
 {
     Chunk* chunk;
-    std::vector<glm::vec4> vboDataOpaque, vboDataTransparent;
+    // The Chunk's epoch when it was meshed; the data is stale once they differ
+    unsigned int epoch;
+    // The one section this data re-meshes, or -1 when it holds the whole Chunk
+    int section;
+    // The version of each section when it was meshed
+    std::array<unsigned int, 16> versions;
+    // Where each section went in the buffers, for whole Chunks only
+    std::array<MeshSlot, 16> slotsOpaque, slotsTransparent;
+    std::vector<ChunkVertex> vboDataOpaque, vboDataTransparent;
     std::vector<GLuint> idxDataOpaque, idxDataTransparent;
 
-    ChunkVBOData(Chunk* c) :
-        chunk(c), vboDataOpaque{}, vboDataTransparent{}, idxDataOpaque{}, idxDataTransparent{}
+    ChunkVBOData(Chunk* c, unsigned int epoch) :
+        chunk(c), epoch(epoch), section(-1), versions{}, slotsOpaque{}, slotsTransparent{},
+        vboDataOpaque{}, vboDataTransparent{}, idxDataOpaque{}, idxDataTransparent{}
     {}
 };
 
 class DrawableChunk : public Drawable {
     friend class Chunk;
 private:
-    bool ptrsValid;
-    std::vector<glm::vec4>* vbo;
-    std::vector<GLuint>* idx;
-    unsigned int* count;
+    std::array<MeshSlot, 16> m_slots;
 
     virtual void createVBOdata();
 
     // for creating chunks using data given by threads
-    void create(std::vector<glm::vec4> &vbo, std::vector<GLuint> &idx);
+    void create(std::vector<ChunkVertex> &vbo, std::vector<GLuint> &idx, const std::array<MeshSlot, 16> &sectionSlots);
+    bool sectionFits(int section, size_t vertices) const;
+    // Overwrites one section's slot with a mesh whose indices start at 0
+    void updateSection(int section, std::vector<ChunkVertex> &vbo, std::vector<GLuint> &idx);
 public:
     DrawableChunk(OpenGLContext* mp_context);
 };
@@ -212,11 +162,110 @@ struct hash_ivec2 {
     }
 };
 
+// One 16 x 16 x 16 cube of a Chunk's blocks.
+// Instead of spending a full byte on every block, a section keeps a palette of
+// the block types it actually contains and bit-packs each block's palette index
+// using 1, 2, 4 or 8 bits (whichever is the smallest that fits the palette).
+// A section made of a single block type (all air, all stone) stores no index
+// data at all and is represented by its one palette entry.
+class BlockSection {
+private:
+    std::vector<BlockType> m_palette;
+    // Packed palette indices, 64 / m_bits of them per word. Empty when uniform.
+    std::vector<uint64_t> m_data;
+    // Bits used per palette index, 0 when the section is uniform
+    unsigned int m_bits;
+
+    unsigned int getIndex(unsigned int i) const;
+    void setIndex(unsigned int i, unsigned int paletteIdx);
+    // Re-packs every index using the given number of bits
+    void resize(unsigned int bits);
+
+public:
+    BlockSection();
+
+    // i is the block's index inside the section, x + 16 * y + 256 * z
+    BlockType get(unsigned int i) const;
+    void set(unsigned int i, BlockType t);
+    // Replaces every block at once, indexed like get()
+    void assign(const BlockType* blocks);
+    // Drops palette entries that are no longer used, collapsing the
+    // section back to a single value if only one block type remains.
+    // Call after bulk writes such as terrain generation.
+    void compact();
+
+    bool isUniform() const;
+    // Approximate heap + inline memory used by this section
+    size_t residentBytes() const;
+};
+
+// A whole Chunk's blocks compressed for the cold tier, which holds Chunks that
+// are loaded but far enough away that nothing meshes or draws them.
+// Every column of 256 blocks is run-length encoded from y = 0 upward against
+// one palette for the Chunk. Terrain columns are mostly a handful of long runs
+// (bedrock, stone, dirt, grass, air), so this takes about two thirds of the
+// memory of the bit-packed BlockSections, and single blocks can still be read
+// without decoding anything but their own column.
+class ColdBlocks {
+private:
+    std::vector<BlockType> m_palette;
+    // Two bytes per run: its palette index, then its length minus one
+    std::vector<unsigned char> m_runs;
+    // Which run each column starts with, indexed x + 16 * z; run i is at m_runs[2 * i]
+    std::array<uint16_t, 256> m_columnStart;
+
+public:
+    ColdBlocks();
+    // Encodes the blocks of a Chunk's sections
+    explicit ColdBlocks(const std::array<BlockSection, 16> &sections);
+
+    BlockType get(unsigned int x, unsigned int y, unsigned int z) const;
+    // Decodes one whole column, from y = 0 upward
+    void getColumn(unsigned int x, unsigned int z, BlockType* out) const;
+
+    size_t residentBytes() const;
+};
+
+// An immutable copy of the blocks a mesher reads: a range of a Chunk's heights
+// plus a one block border of its four neighbors' blocks, with EMPTY wherever
+// there is no neighbor and below and above the world.
+// Meshing looks every neighbor up in here instead of in the live Chunks,
+// so it needs no branches at Chunk borders and no locks.
+class BlockSnapshot {
+    friend class Chunk;
+private:
+    int m_yMin, m_yMax;
+    // 18 x (yMax - yMin + 2) x 18 blocks, x fastest, then z, then y
+    std::vector<BlockType> m_blocks;
+
+    size_t index(int x, int y, int z) const {
+        return (x + 1) + 18 * (z + 1) + 324 * (y - m_yMin + 1);
+    }
+
+public:
+    // An all EMPTY snapshot of heights [yMin, yMax); Chunk fills it in
+    BlockSnapshot(int yMin, int yMax);
+
+    // x and z may be anywhere in [-1, 16] and y in [yMin - 1, yMax].
+    // Defined here so that the meshers' inner loops can inline it.
+    BlockType at(int x, int y, int z) const {
+        return m_blocks[index(x, y, z)];
+    }
+    // The 18 blocks from x = -1 to 16 at the given height and z
+    const BlockType* row(int y, int z) const {
+        return &m_blocks[index(-1, y, z)];
+    }
+};
+
 // TODO have Chunk inherit from Drawable
 class Chunk {
 private:
-    // All of the blocks contained within this Chunk
-    std::array<BlockType, 65536> m_blocks;
+    // All of the blocks contained within this Chunk, split into
+    // sixteen 16-block tall sections ordered from y = 0 upward
+    std::array<BlockSection, 16> m_sections;
+    // Held by whoever writes m_sections or m_neighbors, and while a
+    // snapshot copies them, so that workers never see a half-written Chunk
+    mutable std::mutex blockMutex;
     int minX, minZ;
     int64_t key;
     // This Chunk's four neighbors to the north, south, east, and west
@@ -230,7 +279,66 @@ private:
     std::unordered_map<glm::ivec2, glm::ivec4, hash_ivec2> treesMap;
     std::vector<glm::ivec4> trees;
 
-    std::atomic_bool generated;
+    // Changed with compare-and-swap, since workers move Chunks out of
+    // GENERATING and MESHING while the main thread moves them out of the others
+    std::atomic<ChunkState> m_state;
+    // The biome at the Chunk's center, known once it has been generated
+    BiomeType biome;
+    // Bumped whenever the Chunk is unloaded, so that jobs and VBO data
+    // made for an earlier epoch can tell they are no longer wanted
+    std::atomic_uint epoch;
+    // Bumped whenever a block edit changes what a section's mesh should look like
+    std::array<std::atomic_uint, 16> sectionVersions;
+    // The version of each section in the uploaded mesh. Main thread only.
+    std::array<unsigned int, 16> meshVersions;
+    // The blocks while the Chunk is in the cold tier, when m_sections is all EMPTY.
+    // Null while it is hot. Only the main thread sets or clears it (under
+    // blockMutex), so the main thread reads it without locking.
+    uPtr<ColdBlocks> m_cold;
+    // Bumped by every setBlockAt, so that a compressed copy made before an edit is not used
+    std::atomic_uint blockVersion;
+    // Set once a COMPRESS_JOB is queued, until the result is used or thrown away
+    std::atomic_bool compressRequested;
+    // Jobs pushed for this Chunk that have not finished running yet.
+    // Terrain only deletes a Chunk once it and its neighbors have none.
+    std::atomic_int queuedJobs;
+    // For each HeightmapType, the y of the top block of every column (x + 16 * z),
+    // or -1 for a column with no such block. Written under blockMutex; once the
+    // Chunk is generated only the thread that edits blocks writes them, so that
+    // thread may read them without locking.
+    std::array<std::array<int16_t, 256>, 2> m_heightmaps;
+
+    // The mesher used by every Chunk, switchable while the game runs
+    static std::atomic<MeshingMode> meshingMode;
+    // Recycled buffers that every Chunk is meshed into
+    static MeshBufferPool bufferPool;
+
+    // Decodes m_cold back into m_sections; blockMutex must be held and m_cold set
+    void thawLocked();
+    // Same as setBlockAt, for callers that already hold blockMutex.
+    // Leaves the heightmaps alone; bulk writers rebuild them afterwards.
+    void writeBlock(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // The y of the highest block of the given kind at or below y in the column, or -1
+    int scanColumn(HeightmapType type, unsigned int x, int y, unsigned int z) const;
+    // Recomputes both heights of one column from its blocks; blockMutex must be held
+    void rebuildColumnHeights(unsigned int x, unsigned int z);
+    // Keeps both heights of a column right after one of its blocks became t.
+    // Only scans down when the column's top block is removed.
+    void updateColumnHeights(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // Shrinks the palettes of every section after bulk writes; blockMutex must be held
+    void compactBlocks();
+    // Copies this Chunk's blocks, and its neighbors' blocks around them, into snap
+    void fillSnapshot(BlockSnapshot &snap) const;
+
+    void makeNaiveVBOs(const BlockSnapshot &snap, int section, std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint>& idxOpaque,
+                       std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint>& idxTransparent);
+    void makeGreedyVBOs(const BlockSnapshot &snap, int section, std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint>& idxOpaque,
+                        std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint>& idxTransparent);
+    void makeBitmaskVBOs(const BlockSnapshot &snap, int section, std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint>& idxOpaque,
+                         std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint>& idxTransparent);
+    // Appends the quads of one section to the given vectors
+    void makeSectionVBOs(const BlockSnapshot &snap, int section, std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint>& idxOpaque,
+                         std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint>& idxTransparent);
 
 public:
     Chunk(OpenGLContext* mp_context);
@@ -239,15 +347,58 @@ public:
     DrawableChunk opaque;
     DrawableChunk transparent;
 
+    // Read without blockMutex. Workers write a Chunk's blocks only while it is
+    // generated or loaded, reallocating its sections, and once it is GENERATED
+    // only the main thread writes them. So the main thread may read the blocks of
+    // a Chunk for which isGenerated is true; any other reader must hold blockMutex.
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
+    // Safe to call while workers are meshing this Chunk or its neighbors
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // Memory currently held by this Chunk's block data
+    size_t blockBytes() const;
+    // The y of the top block of the given kind in the column, or -1 if it has none
+    int getHeightAt(HeightmapType type, unsigned int x, unsigned int z) const;
+    // The top block heights of all 256 columns, indexed x + 16 * z
+    const std::array<int16_t, 256>& getHeightmap(HeightmapType type) const;
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // Clears the links between this Chunk and its neighbors, so that it can be deleted
+    void unlinkNeighbors();
+
+    // Cold tier: a worker compresses the blocks with compressBlocks, then the
+    // main thread swaps them in with freeze, which frees the hot sections,
+    // unless the Chunk was edited in between. A cold Chunk still answers
+    // getBlockAt (raycasts and collisions just decode one column) and can be
+    // snapshotted and saved; thaw puts it back in the hot tier, and setBlockAt
+    // thaws it first.
+    // Returns whether the Chunk is hot, generated and not already being compressed,
+    // marking it as being compressed if so
+    bool requestCompression();
+    // Safe on worker threads
+    ColdBlocks compressBlocks(unsigned int &version) const;
+    // Lets the Chunk be compressed again after a compressed copy was thrown away
+    void cancelCompression();
+    // Returns false, leaving the Chunk hot, if it was edited since version
+    bool freeze(ColdBlocks &&cold, unsigned int version);
+    void thaw();
+    bool isCold() const;
+    // Memory the cold blocks take, 0 for a hot Chunk
+    size_t coldBytes() const;
 
     // VBO methods:
-    // Populates the reference vectors for use in threading
-    void makeDrawableVBOs(std::vector<glm::vec4>& vboOpaque, std::vector<GLuint>& idxOpaque,
-                          std::vector<glm::vec4>& vboTransparent, std::vector<GLuint>& idxTransparent);
+    // Populates the reference vectors for use in threading, using the current meshing mode
+    void makeDrawableVBOs(std::vector<ChunkVertex>& vboOpaque, std::vector<GLuint>& idxOpaque,
+                          std::vector<ChunkVertex>& vboTransparent, std::vector<GLuint>& idxTransparent);
+    // Meshes the Chunk into buffers taken from the buffer pool, which
+    // should be given back to it with releaseVBOData once uploaded.
+    // Each section is laid out in its own slot with room to grow.
+    void makeDrawableVBOs(ChunkVBOData &data);
+    // Meshes only one section, for replacing its slot after an edit
+    void makeSectionVBOs(ChunkVBOData &data, int section);
+    static void releaseVBOData(ChunkVBOData &data);
+    static MeshBufferPool& getBufferPool();
+    static void setMeshingMode(MeshingMode mode);
+    static MeshingMode getMeshingMode();
 
     void unravelVBO(std::vector<glm::vec4> &vbo, std::vector<GLuint> &idx,
                     std::vector<glm::vec4> &pos, std::vector<glm::vec4> &col, std::vector<glm::vec4> &nor, std::vector<glm::vec4>& uv);
@@ -260,25 +411,61 @@ public:
     void resetVBOData();
 
     // Helper methods:
-    void getNeighbor(int x, int y, int z, const BlockFace &n, BlockType &neighbor);
-
-    glm::ivec2 getMinPos();
+    glm::ivec2 getMinPos() const;
 
-    BlockType getBlockByBiome(float height, bool onTop, BiomeType b, bool vFlip);
-    void setChunkGenHeights();
+    // Replaces this Chunk's blocks with the ones a GenerationPipeline made,
+    // plants its trees and marks it GENERATED
+    void commitGeneration(const GenerationContext &ctx);
+    // Whether the GPU holds a mesh of this Chunk, which may be out of date
     bool hasVBOData();
     // Sends data for opaque and transparent to GPU
-    void create(std::vector<glm::vec4>& vboDataOpaque, std::vector<GLuint>& idxDataOpaque,
-                std::vector<glm::vec4>& vboDataTransparent, std::vector<GLuint>& idxDataTransparent);
+    void create(ChunkVBOData &data);
+    // Replaces one section of the uploaded mesh with data made by makeSectionVBOs.
+    // Returns false, changing nothing, if the new mesh outgrew the section's slot.
+    bool updateSection(ChunkVBOData &data);
 
     std::vector<glm::ivec4>& getTrees();
     void clearTrees();
     std::unordered_map<Direction, Chunk*, EnumHash>& getNeighbors();
 
     int64_t getKey();
-    void load(QString savename);
+    void load(QString savename, const TerrainGen &gen);
     void save(QString savename);
 
-    bool canCreate();
+    ChunkState getState() const;
+    static bool canTransition(ChunkState from, ChunkState to);
+    // Moves the Chunk to the given state from whichever one it is in.
+    // Throws std::logic_error if that state cannot move there.
+    void setState(ChunkState to);
+    // Moves the Chunk from one state to another, returning false and changing
+    // nothing if it is not in the first one. Throws std::logic_error if the
+    // first state cannot move to the second.
+    bool tryTransition(ChunkState from, ChunkState to);
+    // Moves a meshed Chunk back to MESHING, so that it is meshed again in full.
+    // Returns false if it has no mesh yet or a full mesh is already queued.
+    bool requestRemesh();
+    // Whether all four neighbors are loaded and generated, so that the Chunk
+    // can be meshed. Main thread only, like linking and unlinking neighbors.
+    bool neighborsGenerated() const;
+    // Whether the uploaded mesh was made from the current version of every section
+    bool meshUpToDate() const;
+
+    BiomeType getBiome() const;
+    // Whether the blocks (and heightmaps) have been generated or loaded
+    bool isGenerated() const;
+
+    unsigned int getEpoch() const;
+    // Invalidates every queued job and pending VBO data of this Chunk,
+    // moving it back to GENERATED if it had a mesh or was being meshed
+    void bumpEpoch();
+
+    // Called by JobSystem as a job for this Chunk is pushed and once it has run
+    void jobQueued();
+    void jobFinished();
+    bool hasQueuedJobs() const;
+
+    unsigned int getSectionVersion(int section) const;
+    // Marks a section's current mesh as out of date
+    void bumpSectionVersion(int section);
 };
 
@@ -0,0 +1,38 @@
+#include "chunkgrid.h"
+#include "terrain.h"
+
+ChunkGrid::ChunkGrid()
+    : m_slots(), m_min(-CHUNK_GRID_SIZE / 2)
+{
+    // Start out centred on the origin with no Chunks loaded
+    for (int cz = m_min.y; cz < m_min.y + CHUNK_GRID_SIZE; cz++) {
+        for (int cx = m_min.x; cx < m_min.x + CHUNK_GRID_SIZE; cx++) {
+            m_slots[slotIndex(cx, cz)] = {glm::ivec2(cx, cz), nullptr};
+        }
+    }
+}
+
+void ChunkGrid::set(int cx, int cz, Chunk* c) {
+    if (contains(cx, cz)) {
+        m_slots[slotIndex(cx, cz)] = {glm::ivec2(cx, cz), c};
+    }
+}
+
+glm::ivec2 ChunkGrid::getCentre() const {
+    return m_min + glm::ivec2(CHUNK_GRID_SIZE / 2);
+}
+
+void ChunkGrid::recentre(glm::ivec2 centre, const std::unordered_map<int64_t, uPtr<Chunk>> &chunks) {
+    m_min = centre - glm::ivec2(CHUNK_GRID_SIZE / 2);
+    for (int cz = m_min.y; cz < m_min.y + CHUNK_GRID_SIZE; cz++) {
+        for (int cx = m_min.x; cx < m_min.x + CHUNK_GRID_SIZE; cx++) {
+            Slot &s = m_slots[slotIndex(cx, cz)];
+            // Slots still within the old grid already hold the right Chunk
+            if (s.coords == glm::ivec2(cx, cz)) {
+                continue;
+            }
+            auto it = chunks.find(toKey(16 * cx, 16 * cz));
+            s = {glm::ivec2(cx, cz), it == chunks.end() ? nullptr : it->second.get()};
+        }
+    }
+}
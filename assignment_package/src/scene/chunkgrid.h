@@ -0,0 +1,56 @@
+#pragma once
+#include "chunk.h"
+#include <unordered_map>
+
+// Number of Chunks along each side of the ChunkGrid. Must be a power of two,
+// and covers CREATE_RADIUS (5 zones, or 20 Chunks) with room to spare.
+#define CHUNK_GRID_SIZE 32
+
+// A toroidal CHUNK_GRID_SIZE x CHUNK_GRID_SIZE array of Chunk pointers
+// around the player, so that block lookups near them need neither a
+// division nor a hash map lookup. Coordinates here are Chunk coordinates,
+// i.e. world coordinates shifted right by 4.
+// The grid wraps around: the Chunk at (cx, cz) always lives in slot
+// (cx & 31, cz & 31), so moving the grid only rewrites the rows and
+// columns that scrolled in. Terrain's hash map is still what owns the
+// Chunks; the grid has to be told whenever one is added or removed.
+class ChunkGrid {
+private:
+    struct Slot {
+        // The Chunk coordinates this slot was last filled for
+        glm::ivec2 coords;
+        // Null if there is no Chunk there
+        Chunk* chunk;
+    };
+    std::array<Slot, CHUNK_GRID_SIZE * CHUNK_GRID_SIZE> m_slots;
+    // Chunk coordinates of the grid's lower-left corner
+    glm::ivec2 m_min;
+
+    static int slotIndex(int cx, int cz) {
+        return (cx & (CHUNK_GRID_SIZE - 1)) + CHUNK_GRID_SIZE * (cz & (CHUNK_GRID_SIZE - 1));
+    }
+
+public:
+    ChunkGrid();
+
+    // Whether the Chunk at these Chunk coordinates falls within the grid
+    bool contains(int cx, int cz) const {
+        // One unsigned comparison per axis also catches coordinates below m_min
+        return static_cast<unsigned int>(cx - m_min.x) < CHUNK_GRID_SIZE &&
+               static_cast<unsigned int>(cz - m_min.y) < CHUNK_GRID_SIZE;
+    }
+    // The Chunk at these Chunk coordinates, or null if there is none.
+    // Only valid when contains(cx, cz).
+    Chunk* get(int cx, int cz) const {
+        return m_slots[slotIndex(cx, cz)].chunk;
+    }
+    // Records that the Chunk at these Chunk coordinates was created (or
+    // deleted, when c is null). Does nothing outside the grid.
+    void set(int cx, int cz, Chunk* c);
+
+    // Chunk coordinates of the Chunk at the centre of the grid
+    glm::ivec2 getCentre() const;
+    // Moves the grid so that it is centred on the given Chunk coordinates,
+    // filling the slots that came into range from chunks
+    void recentre(glm::ivec2 centre, const std::unordered_map<int64_t, uPtr<Chunk>> &chunks);
+};
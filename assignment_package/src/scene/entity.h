@@ -29,6 +29,8 @@ protected:
 public:
     // A readonly reference to position for external use
     const glm::vec3& mcr_position;
+    // A readonly reference to the direction we face
+    const glm::vec3& mcr_forward;
 
     // Various constructors
     Entity();
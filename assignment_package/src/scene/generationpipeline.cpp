@@ -0,0 +1,259 @@
+#include "generationpipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+GenerationContext::GenerationContext(glm::ivec2 minPos, const TerrainGen &gen, const ZoneFields *fields)
+    : minPos(minPos), gen(&gen), fields(fields), columns(), tops(), blocks(65536, EMPTY), treeSites()
+{
+    tops.fill(0);
+    treeSites.fill(false);
+}
+
+BlockType GenerationContext::getBlock(int x, int y, int z) const {
+    if (x < 0 || x >= 16 || y < 0 || y >= 256 || z < 0 || z >= 16) {
+        throw std::out_of_range("block index out of chunk bounds");
+    }
+    return blocks[4096 * (y >> 4) + x + 16 * (y & 15) + 256 * z];
+}
+
+void GenerationContext::setBlock(int x, int y, int z, BlockType t) {
+    if (x < 0 || x >= 16 || y < 0 || y >= 256 || z < 0 || z >= 16) {
+        throw std::out_of_range("block index out of chunk bounds");
+    }
+    blocks[4096 * (y >> 4) + x + 16 * (y & 15) + 256 * z] = t;
+}
+
+GenerationTask::GenerationTask(glm::ivec2 minPos, const TerrainGen &gen, sPtr<const ZoneFields> fields, int strips)
+    : context(minPos, gen, fields.get()), fields(fields), strips(strips), stage(0), stripsLeft(0)
+{}
+
+namespace {
+
+BlockType getBlockByBiome(float height, bool onTop, BiomeType b, bool vFlip) {
+    if (height <= 128) return BlockType::STONE;
+    if (b == GRASSLANDS) {
+        return onTop ? BlockType::GRASS : BlockType::DIRT;
+    } else if (b == MOUNTAINS) {
+        //switch to snow
+        return height > 200 && onTop ? BlockType::SNOW : BlockType::STONE;
+    } else if (b == VOLCANO) {
+        return vFlip ? BlockType::LAVA : BlockType::OBSIDIAN;
+    }
+    return BlockType::EMPTY;
+}
+
+// The height and biome of every column
+void densityStage(GenerationContext &ctx, int zBegin, int zEnd) {
+    ctx.gen->getHeights(ctx.minPos + glm::ivec2(0, zBegin), glm::ivec2(16, zEnd - zBegin),
+                        &ctx.columns[16 * zBegin], ctx.fields);
+}
+
+// Fills each column up to its height with its biome's blocks
+void surfaceStage(GenerationContext &ctx, int zBegin, int zEnd) {
+    for (int x = 0; x < 16; x++) {
+        for (int z = zBegin; z < zEnd; z++) {
+            ColumnHeight &column = ctx.columns[x + 16 * z];
+            if (column.vFlip && column.biome == VOLCANO) {
+                column.height = 130;
+            }
+
+            //set blocks
+            for (int y = 1; y <= column.height; y++) {
+                ctx.setBlock(x, y, z, getBlockByBiome(column.height, y == column.height, column.biome, column.vFlip));
+            }
+            ctx.tops[x + 16 * z] = column.height;
+        }
+    }
+}
+
+// Carves caves below y = 150 out of the columns filled up to their tops. Cave noise
+// is sampled on a lattice with the TerrainGen's cave spacing and interpolated in
+// between, skipping the cells whose corners show nothing is carved in them.
+void carverStage(GenerationContext &ctx, int, int) {
+    const int spacing = ctx.gen->getCaveSpacing();
+    int maxY = 0;
+    for (int top : ctx.tops) {
+        maxY = std::max(maxY, std::min(top, 149));
+    }
+    // "Floor" height of terrain is about 128
+    // Want Perlin value to increase closer to surface so caves are smaller
+    std::array<double, 150> bias;
+    for (int y = 0; y < 150; y++) {
+        bias[y] = pow(glm::smoothstep(100.f, 130.f, (float)y), 2) * 0.3;
+    }
+
+    // Noise at every lattice point, (x, z) index (i + n * k) on level j
+    const int n = 16 / spacing + 1, levels = maxY / spacing + 2;
+    std::vector<float> samples(n * n * levels);
+    for (int j = 0; j < levels; j++) {
+        for (int k = 0; k < n; k++) {
+            for (int i = 0; i < n; i++) {
+                samples[i + n * (k + n * j)] = ctx.gen->perlinNoise3D(
+                            glm::vec3(ctx.minPos.x + i * spacing, j * spacing, ctx.minPos.y + k * spacing) / 25.f);
+            }
+        }
+    }
+
+    for (int j = 0; j < levels - 1; j++) {
+        for (int k = 0; k < n - 1; k++) {
+            for (int i = 0; i < n - 1; i++) {
+                float c[8];
+                for (int corner = 0; corner < 8; corner++) {
+                    c[corner] = samples[i + (corner & 1) + n * (k + (corner >> 1 & 1) + n * (j + (corner >> 2)))];
+                }
+                // Interpolated noise never drops below its lowest corner, and the bias only
+                // grows with y, so if neither can go negative no block of the cell is carved
+                int y0 = j * spacing;
+                if (*std::min_element(c, c + 8) + bias[y0] >= 0.f) {
+                    continue;
+                }
+                for (int dz = 0; dz < spacing; dz++) {
+                    for (int dx = 0; dx < spacing; dx++) {
+                        int x = i * spacing + dx, z = k * spacing + dz;
+                        int top = std::min(ctx.tops[x + 16 * z], 149);
+                        float tx = float(dx) / spacing, tz = float(dz) / spacing;
+                        float lower = glm::mix(glm::mix(c[0], c[1], tx), glm::mix(c[2], c[3], tx), tz);
+                        float upper = glm::mix(glm::mix(c[4], c[5], tx), glm::mix(c[6], c[7], tx), tz);
+                        for (int y = std::max(y0, 1); y < y0 + spacing && y <= top; y++) {
+                            float perlin3D = glm::mix(lower, upper, float(y - y0) / spacing);
+                            perlin3D += bias[y];
+
+                            //cave limit of perlin val
+                            if (perlin3D < 0.f) {
+                                //25 -- above is empty, below is lava
+                                ctx.setBlock(x, y, z, y > 25 ? BlockType::EMPTY : BlockType::LAVA);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Water pools and bedrock
+void fluidStage(GenerationContext &ctx, int zBegin, int zEnd) {
+    for (int x = 0; x < 16; x++) {
+        for (int z = zBegin; z < zEnd; z++) {
+            int height = ctx.columns[x + 16 * z].height;
+            BiomeType b = ctx.columns[x + 16 * z].biome;
+
+            //make water pools from [128, 138)
+            if (height >= 127 && ctx.getBlock(x, height, z) != BlockType::EMPTY && b != VOLCANO) {
+                for (int y = height + 1; y < 138; y++) {
+                    if (ctx.getBlock(x, y, z) == BlockType::EMPTY) {
+                        ctx.setBlock(x, y, z, BlockType::WATER);
+                    }
+                }
+            }
+            ctx.setBlock(x, 0, z, BlockType::BEDROCK);
+        }
+    }
+}
+
+// Picks the grassland columns trees grow from
+void decorationStage(GenerationContext &ctx, int zBegin, int zEnd) {
+    for (int x = 0; x < 16; x++) {
+        for (int z = zBegin; z < zEnd; z++) {
+            ctx.treeSites[x + 16 * z] = ctx.columns[x + 16 * z].biome == GRASSLANDS
+                    && ctx.gen->WorleyNoise3(ctx.minPos.x + x, ctx.minPos.y + z) > 0.96;
+        }
+    }
+}
+
+}
+
+GenerationPipeline::GenerationPipeline()
+    : m_stages(), m_timings(), m_outputs(0)
+{}
+
+GenerationPipeline GenerationPipeline::defaultPipeline() {
+    GenerationPipeline pipeline;
+    pipeline.addStage({"density", 0, COLUMN_HEIGHTS, COLUMN_PARALLEL, densityStage});
+    pipeline.addStage({"surface", COLUMN_HEIGHTS, COLUMN_HEIGHTS | COLUMN_TOPS | BLOCK_DATA, COLUMN_PARALLEL, surfaceStage});
+    pipeline.addStage({"carvers", COLUMN_TOPS | BLOCK_DATA, BLOCK_DATA, WHOLE_CHUNK, carverStage});
+    pipeline.addStage({"fluids", COLUMN_HEIGHTS | BLOCK_DATA, BLOCK_DATA, COLUMN_PARALLEL, fluidStage});
+    pipeline.addStage({"decorations", COLUMN_HEIGHTS, TREE_SITES, COLUMN_PARALLEL, decorationStage});
+    return pipeline;
+}
+
+void GenerationPipeline::addStage(GenerationStage stage) {
+    if ((stage.inputs & ~m_outputs) != 0) {
+        throw std::invalid_argument("generation stage " + stage.name + " reads data no earlier stage writes");
+    }
+    m_outputs |= stage.outputs;
+    m_stages.push_back(stage);
+    m_timings.push_back(mkU<StageTiming>());
+    m_timings.back()->nanos = 0;
+    m_timings.back()->chunks = 0;
+}
+
+int GenerationPipeline::stageCount() const {
+    return m_stages.size();
+}
+
+const GenerationStage& GenerationPipeline::getStage(int i) const {
+    return m_stages.at(i);
+}
+
+void GenerationPipeline::runStage(GenerationContext &ctx, int i, int zBegin, int zEnd) const {
+    auto start = std::chrono::steady_clock::now();
+    m_stages[i].run(ctx, zBegin, zEnd);
+    auto end = std::chrono::steady_clock::now();
+    m_timings[i]->nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    // Counted once per Chunk, by its first strip
+    if (zBegin == 0) {
+        m_timings[i]->chunks++;
+    }
+}
+
+void GenerationPipeline::run(GenerationContext &ctx) const {
+    for (int i = 0; i < stageCount(); i++) {
+        runStage(ctx, i, 0, 16);
+    }
+}
+
+bool GenerationPipeline::advance(GenerationTask &task, const std::function<void(int)> &spawnStrip) const {
+    for (; task.stage < stageCount(); task.stage++) {
+        if (m_stages[task.stage].parallelism == COLUMN_PARALLEL && task.strips > 1) {
+            task.stripsLeft = task.strips;
+            for (int i = 1; i < task.strips; i++) {
+                spawnStrip(i);
+            }
+            return runStrip(task, 0, spawnStrip);
+        }
+        runStage(task.context, task.stage, 0, 16);
+    }
+    return true;
+}
+
+bool GenerationPipeline::start(GenerationTask &task, const std::function<void(int)> &spawnStrip) const {
+    task.stage = 0;
+    return advance(task, spawnStrip);
+}
+
+bool GenerationPipeline::runStrip(GenerationTask &task, int strip, const std::function<void(int)> &spawnStrip) const {
+    runStage(task.context, task.stage, 16 * strip / task.strips, 16 * (strip + 1) / task.strips);
+    // The strips write disjoint rows; whichever finishes last sees all of them
+    if (task.stripsLeft.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return false;
+    }
+    task.stage++;
+    return advance(task, spawnStrip);
+}
+
+double GenerationPipeline::getStageMillis(int i) const {
+    return m_timings.at(i)->nanos / 1e6;
+}
+
+int GenerationPipeline::getStageChunks(int i) const {
+    return m_timings.at(i)->chunks;
+}
+
+void GenerationPipeline::resetTimings() {
+    for (uPtr<StageTiming> &t : m_timings) {
+        t->nanos = 0;
+        t->chunks = 0;
+    }
+}
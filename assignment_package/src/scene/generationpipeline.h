@@ -0,0 +1,132 @@
+#pragma once
+#include "terraingen.h"
+#include "blockregistry.h"
+#include "smartpointerhelp.h"
+#include <array>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Strips of rows a COLUMN_PARALLEL stage is split into when a Chunk's
+// generation is spread over several workers. Must divide 16.
+#define GENERATION_STRIPS 4
+
+// What a GenerationStage reads from and writes to a GenerationContext, as bit flags
+enum GenerationData : unsigned int {
+    COLUMN_HEIGHTS = 1 << 0, // columns: the height and biome of every column
+    COLUMN_TOPS    = 1 << 1, // tops: how far up the surface filled each column
+    BLOCK_DATA     = 1 << 2, // blocks
+    TREE_SITES     = 1 << 3  // treeSites
+};
+
+// How the job system may spread a stage's work
+enum GenerationParallelism {
+    // Each column reads and writes only its own data, so a Chunk's rows can be
+    // split into strips that run on different workers
+    COLUMN_PARALLEL,
+    // Columns read each other's data (caves interpolate one lattice across the
+    // Chunk), so the stage runs on the whole Chunk on one worker
+    WHOLE_CHUNK
+};
+
+// Everything one Chunk's generation works on. Stages write here rather than to
+// the Chunk, which takes the result in Chunk::commitGeneration, so no stage needs
+// the Chunk's lock and strips of a stage never write the same data.
+// Columns are indexed x + 16 * z.
+struct GenerationContext {
+    glm::ivec2 minPos;
+    const TerrainGen* gen;
+    // The fields of the Chunk's zone, or null to evaluate every term per column
+    const ZoneFields* fields;
+
+    std::array<ColumnHeight, 256> columns;
+    std::array<int, 256> tops;
+    // Indexed like the Chunk's sections: 4096 * (y / 16) + x + 16 * (y % 16) + 256 * z
+    std::vector<BlockType> blocks;
+    // Columns a tree grows from, planted at their height once committed
+    std::array<bool, 256> treeSites;
+
+    GenerationContext(glm::ivec2 minPos, const TerrainGen &gen, const ZoneFields *fields);
+
+    // Throws std::out_of_range outside the Chunk, as Chunk::setBlockAt does
+    BlockType getBlock(int x, int y, int z) const;
+    void setBlock(int x, int y, int z, BlockType t);
+};
+
+struct GenerationStage {
+    std::string name;
+    // GenerationData flags
+    unsigned int inputs, outputs;
+    GenerationParallelism parallelism;
+    // Runs the stage on the rows z in [zBegin, zEnd) of the context's Chunk.
+    // WHOLE_CHUNK stages are always given the whole Chunk.
+    std::function<void(GenerationContext&, int zBegin, int zEnd)> run;
+};
+
+// A Chunk's generation whose COLUMN_PARALLEL stages are split into strips
+// that run as separate jobs. The last strip of a stage to finish carries on
+// with the stages after it.
+struct GenerationTask {
+    GenerationContext context;
+    // Keeps context.fields alive while the strips run
+    sPtr<const ZoneFields> fields;
+    // Strips each COLUMN_PARALLEL stage is split into; 1 runs every stage on one thread
+    int strips;
+    // The stage running, and how many of its strips have not finished
+    int stage;
+    std::atomic_int stripsLeft;
+
+    GenerationTask(glm::ivec2 minPos, const TerrainGen &gen, sPtr<const ZoneFields> fields, int strips);
+};
+
+// The stages that turn noise into a Chunk's blocks, run in order. Each stage
+// declares the data it reads and writes, and the time spent in each is recorded
+// across every Chunk generated, from whichever thread.
+class GenerationPipeline {
+private:
+    struct StageTiming {
+        std::atomic<int64_t> nanos;
+        std::atomic_int chunks;
+    };
+
+    std::vector<GenerationStage> m_stages;
+    std::vector<uPtr<StageTiming>> m_timings;
+    // GenerationData written by the stages so far
+    unsigned int m_outputs;
+
+    // Runs the stages from task.stage on, up to the first that is split into strips
+    bool advance(GenerationTask &task, const std::function<void(int)> &spawnStrip) const;
+
+public:
+    GenerationPipeline();
+    // Density and height, surface, carvers, fluids and decorations. Gives the same
+    // blocks as the single-pass generator it replaced, with batched heights and
+    // interpolated caves, which themselves differ slightly from the original
+    // per-column generator; checkNoiseHash pins the Chunks it makes.
+    static GenerationPipeline defaultPipeline();
+
+    // Appends a stage. Throws std::invalid_argument if it reads data
+    // that no stage before it writes.
+    void addStage(GenerationStage stage);
+    int stageCount() const;
+    const GenerationStage& getStage(int i) const;
+
+    // Runs stage i on the rows z in [zBegin, zEnd) and records how long it took
+    void runStage(GenerationContext &ctx, int i, int zBegin, int zEnd) const;
+    // Runs every stage in order on the calling thread
+    void run(GenerationContext &ctx) const;
+    // Starts running task on the calling thread. Each time it reaches a COLUMN_PARALLEL
+    // stage, calls spawnStrip(i) for strips 1 to task.strips - 1, each of which must
+    // be passed to runStrip on some thread, and runs strip 0 itself.
+    // Returns true if every stage has run, false if a strip elsewhere will finish the task.
+    bool start(GenerationTask &task, const std::function<void(int)> &spawnStrip) const;
+    // Runs one strip of task's current stage, then carries on as start does
+    // if it was the stage's last strip to finish
+    bool runStrip(GenerationTask &task, int strip, const std::function<void(int)> &spawnStrip) const;
+
+    // Milliseconds spent in stage i, summed over its strips, and the Chunks it ran on
+    double getStageMillis(int i) const;
+    int getStageChunks(int i) const;
+    void resetTimings();
+};
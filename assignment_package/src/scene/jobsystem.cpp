@@ -0,0 +1,179 @@
+#include "jobsystem.h"
+#include "chunk.h"
+
+// Index of the worker running on this thread, -1 on any other thread
+static thread_local int currentWorker = -1;
+
+// Orders std::push_heap and friends so that the lowest priority is on top
+static bool runsLater(const ChunkJob &a, const ChunkJob &b)
+{
+    return a.priority > b.priority;
+}
+
+ChunkJob::ChunkJob()
+    : ChunkJob(GENERATE_JOB, nullptr)
+{}
+
+ChunkJob::ChunkJob(ChunkJobType type, Chunk* c)
+    : type(type), chunk(c), priority(0.f), epoch(0), section(0), generation()
+{}
+
+JobSystem::JobSystem(int numWorkers, std::function<void(const ChunkJob&)> work)
+    : m_queues(), m_threads(), m_work(work), m_queued(0), m_pending(0), m_nextQueue(0),
+      m_focusPos(0.f), m_focusDir(0.f, -1.f), m_focusMutex(), m_sleepMutex(), m_wake(), m_terminate(false)
+{
+    for (int i = 0; i < numWorkers; i++)
+    {
+        m_queues.push_back(mkU<WorkerQueue>());
+    }
+    for (int i = 0; i < numWorkers; i++)
+    {
+        m_threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_terminate = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &t : m_threads)
+    {
+        t.join();
+    }
+}
+
+float JobSystem::computePriority(const ChunkJob &job)
+{
+    // Jobs of unloaded Chunks return at once, and until they do the
+    // Chunk cannot be deleted, so they go before everything else
+    if (job.epoch != job.chunk->getEpoch())
+    {
+        return -2.f;
+    }
+    // The player is waiting to see their edit, so it jumps the queue,
+    // as do the strips that a started generation is waiting on
+    if (job.type == SECTION_MESH_JOB || job.type == GENERATE_STRIP_JOB)
+    {
+        return -1.f;
+    }
+    glm::vec2 center = glm::vec2(job.chunk->getMinPos()) + glm::vec2(8.f);
+    std::lock_guard<std::mutex> lock(m_focusMutex);
+    glm::vec2 toChunk = center - m_focusPos;
+    float dist = glm::length(toChunk);
+    // The Chunk the player stands in always comes first
+    if (dist < 16.f)
+    {
+        return dist;
+    }
+    // Half the distance straight ahead, double it straight behind
+    float facing = glm::dot(toChunk / dist, m_focusDir);
+    return dist * (1.25f - 0.75f * facing);
+}
+
+void JobSystem::push(ChunkJob job)
+{
+    int worker = (currentWorker != -1) ? currentWorker : m_nextQueue++ % m_queues.size();
+    job.epoch = job.chunk->getEpoch();
+    job.priority = computePriority(job);
+    job.chunk->jobQueued();
+    m_pending++;
+    {
+        std::lock_guard<std::mutex> lock(m_queues[worker]->mutex);
+        m_queues[worker]->jobs.push_back(job);
+        std::push_heap(m_queues[worker]->jobs.begin(), m_queues[worker]->jobs.end(), runsLater);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_queued++;
+    }
+    m_wake.notify_one();
+}
+
+void JobSystem::setFocus(glm::vec3 pos, glm::vec3 forward)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_focusMutex);
+        m_focusPos = glm::vec2(pos.x, pos.z);
+        glm::vec2 dir(forward.x, forward.z);
+        // Looking straight up or down, so nothing is in front of the player
+        m_focusDir = (glm::length(dir) > 0.001f) ? glm::normalize(dir) : glm::vec2(0.f);
+    }
+    for (uPtr<WorkerQueue> &q : m_queues)
+    {
+        std::lock_guard<std::mutex> lock(q->mutex);
+        for (ChunkJob &job : q->jobs)
+        {
+            job.priority = computePriority(job);
+        }
+        std::make_heap(q->jobs.begin(), q->jobs.end(), runsLater);
+    }
+}
+
+int JobSystem::pendingJobs() const
+{
+    return m_pending.load();
+}
+
+bool JobSystem::popJob(WorkerQueue &q, ChunkJob &job)
+{
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.jobs.empty())
+    {
+        return false;
+    }
+    std::pop_heap(q.jobs.begin(), q.jobs.end(), runsLater);
+    job = q.jobs.back();
+    q.jobs.pop_back();
+    m_queued--;
+    return true;
+}
+
+bool JobSystem::takeJob(int worker, ChunkJob &job)
+{
+    if (popJob(*m_queues[worker], job))
+    {
+        return true;
+    }
+    // Out of work, so steal, visiting the others in turn from the next worker
+    int n = m_queues.size();
+    for (int i = 1; i < n; i++)
+    {
+        if (popJob(*m_queues[(worker + i) % n], job))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::workerLoop(int worker)
+{
+    currentWorker = worker;
+    while (true)
+    {
+        ChunkJob job;
+        if (takeJob(worker, job))
+        {
+            // Once quitting, only saves still run; unsaved edits would be lost,
+            // while everything else would be thrown away with the Terrain
+            if (!m_terminate || job.type == SAVE_JOB)
+            {
+                m_work(job);
+            }
+            job.chunk->jobFinished();
+            m_pending--;
+            continue;
+        }
+
+        // Sleep until something is pushed; only quit once every queued job is taken
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_queued.load() > 0 || m_terminate; });
+        if (m_terminate && m_queued.load() == 0)
+        {
+            return;
+        }
+    }
+}
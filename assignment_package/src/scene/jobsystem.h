@@ -0,0 +1,107 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include "glm_includes.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Chunk;
+struct GenerationTask;
+
+// The kinds of work Terrain hands to its worker threads
+enum ChunkJobType : unsigned char
+{
+    GENERATE_JOB, // fill in the Chunk's blocks, either from noise or its save file
+    MESH_JOB,     // build the Chunk's VBO data
+    SECTION_MESH_JOB, // re-mesh one section of the Chunk after an edit
+    SAVE_JOB,     // write the Chunk to its save file
+    COMPRESS_JOB, // compress the blocks of a Chunk outside CREATE_RADIUS for the cold tier
+    GENERATE_STRIP_JOB // run one strip of a generation stage split among the workers
+};
+
+struct ChunkJob
+{
+    ChunkJobType type;
+    Chunk* chunk;
+    // Lower runs first; filled in by JobSystem from the Chunk's position
+    float priority;
+    // The Chunk's epoch when the job was pushed; filled in by JobSystem
+    unsigned int epoch;
+    // Which 16 block tall section a SECTION_MESH_JOB re-meshes,
+    // or which strip of its generation a GENERATE_STRIP_JOB runs
+    int section;
+    // The generation a GENERATE_STRIP_JOB runs a strip of
+    sPtr<GenerationTask> generation;
+
+    ChunkJob();
+    // A job of the given type on c, with section 0 and no generation;
+    // its priority and epoch are filled in when it is pushed
+    ChunkJob(ChunkJobType type, Chunk* c);
+};
+
+// A fixed pool of worker threads that sleep on a condition variable until
+// jobs are pushed. Every worker owns a heap of jobs ordered by priority; jobs
+// pushed from the main thread are dealt out round-robin, jobs pushed by a worker
+// (e.g. meshing a Chunk it just generated) go to its own heap. A free worker
+// takes the most urgent job of its own heap, and only once that is empty
+// steals the most urgent job of another worker's heap.
+// A job's priority is the distance from the focus (the player) to its Chunk,
+// scaled down for Chunks in front of the camera and up for those behind it.
+// Jobs whose Chunk was unloaded after they were pushed come before all others
+// once priorities are recomputed, since they do nothing but hold the Chunk in memory.
+class JobSystem {
+private:
+    struct WorkerQueue
+    {
+        // A min-heap on ChunkJob::priority
+        std::vector<ChunkJob> jobs;
+        std::mutex mutex;
+    };
+
+    std::vector<uPtr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    // Called by the workers to actually carry out a job
+    std::function<void(const ChunkJob&)> m_work;
+
+    // Jobs sitting in a heap, waiting for a worker
+    std::atomic_int m_queued;
+    // Jobs that have been pushed but not yet finished, including the ones running
+    std::atomic_int m_pending;
+    std::atomic_uint m_nextQueue;
+
+    // Where the player is and which way they are looking on the xz plane
+    glm::vec2 m_focusPos, m_focusDir;
+    std::mutex m_focusMutex;
+    float computePriority(const ChunkJob &job);
+
+    // Guards sleeping on m_wake so that a push can never be missed
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic_bool m_terminate;
+
+    // Pops the most urgent job of one heap, if it has any
+    bool popJob(WorkerQueue &q, ChunkJob &job);
+    // Pops the most urgent job of the worker's own heap, or if that is
+    // empty, steals one from the next worker that has any
+    bool takeJob(int worker, ChunkJob &job);
+    void workerLoop(int worker);
+
+public:
+    JobSystem(int numWorkers, std::function<void(const ChunkJob&)> work);
+    // Runs the saves that are still queued, drops every other queued job
+    // as if its Chunk had been unloaded, then joins the workers
+    ~JobSystem();
+
+    void push(ChunkJob job);
+
+    // Moves the focus that jobs are prioritized around and re-sorts every queued job
+    void setFocus(glm::vec3 pos, glm::vec3 forward);
+
+    // Number of jobs pushed that have not finished yet. Since a job's follow-up
+    // jobs are pushed before it finishes, this only reaches 0 once all work is done.
+    int pendingJobs() const;
+};
@@ -0,0 +1,106 @@
+#include "meshbufferpool.h"
+#include <cmath>
+
+// How many cleared buffers of each kind the pool holds on to
+#define MAX_FREE_BUFFERS 64
+
+// Weight a new mesh gets in its biome's running average
+static const float sizeSmoothing = 0.1f;
+// Extra room reserved above the running average, so that most meshes fit
+static const float sizeHeadroom = 1.25f;
+
+MeshBufferPool::MeshBufferPool()
+    : m_freeVertices(), m_freeIndices(), m_expectedSize(), m_mutex(), m_allocations(0)
+{
+    // A starting guess for a greedy meshed Chunk, refined by recordMesh
+    for (auto &sizes : m_expectedSize)
+    {
+        sizes = {4096.f, 6144.f, 256.f, 384.f};
+    }
+}
+
+int MeshBufferPool::growthAllocations(size_t from, size_t to)
+{
+    if (to <= from)
+    {
+        return 0;
+    }
+    // Empty vectors allocate once for their first element,
+    // after which every reallocation doubles the capacity
+    int count = (from == 0) ? 1 : 0;
+    from = std::max(from, size_t(1));
+    return count + static_cast<int>(std::ceil(std::log2(double(to) / from)));
+}
+
+template <typename T>
+size_t MeshBufferPool::reserveFrom(std::vector<std::vector<T>> &freeList, std::vector<T> &out, size_t size)
+{
+    if (!freeList.empty())
+    {
+        out = std::move(freeList.back());
+        freeList.pop_back();
+    }
+    else
+    {
+        out = std::vector<T>();
+    }
+    if (out.capacity() < size)
+    {
+        out.reserve(size);
+        m_allocations++;
+    }
+    return out.capacity();
+}
+
+std::array<size_t, 4> MeshBufferPool::acquire(ChunkVBOData &data, BiomeType biome, float fraction)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::array<float, 4> &expected = m_expectedSize[biome];
+    const float scale = sizeHeadroom * fraction;
+    std::array<size_t, 4> reserved;
+    reserved[0] = reserveFrom(m_freeVertices[0], data.vboDataOpaque, expected[0] * scale);
+    reserved[1] = reserveFrom(m_freeIndices[0], data.idxDataOpaque, expected[1] * scale);
+    reserved[2] = reserveFrom(m_freeVertices[1], data.vboDataTransparent, expected[2] * scale);
+    reserved[3] = reserveFrom(m_freeIndices[1], data.idxDataTransparent, expected[3] * scale);
+    return reserved;
+}
+
+void MeshBufferPool::recordMesh(const ChunkVBOData &data, BiomeType biome, const std::array<size_t, 4> &reserved)
+{
+    std::array<size_t, 4> sizes = {data.vboDataOpaque.size(), data.idxDataOpaque.size(),
+                                   data.vboDataTransparent.size(), data.idxDataTransparent.size()};
+    std::array<size_t, 4> capacities = {data.vboDataOpaque.capacity(), data.idxDataOpaque.capacity(),
+                                        data.vboDataTransparent.capacity(), data.idxDataTransparent.capacity()};
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < 4; i++)
+    {
+        m_expectedSize[biome][i] += sizeSmoothing * (sizes[i] - m_expectedSize[biome][i]);
+        m_allocations += growthAllocations(reserved[i], capacities[i]);
+    }
+}
+
+template <typename T>
+void MeshBufferPool::giveBack(std::vector<std::vector<T>> &freeList, std::vector<T> &buffer)
+{
+    if (buffer.capacity() > 0 && freeList.size() < MAX_FREE_BUFFERS)
+    {
+        buffer.clear();
+        freeList.push_back(std::move(buffer));
+    }
+    // Anything the pool has no room for is freed here
+    buffer = std::vector<T>();
+}
+
+void MeshBufferPool::release(ChunkVBOData &data)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    giveBack(m_freeVertices[0], data.vboDataOpaque);
+    giveBack(m_freeIndices[0], data.idxDataOpaque);
+    giveBack(m_freeVertices[1], data.vboDataTransparent);
+    giveBack(m_freeIndices[1], data.idxDataTransparent);
+}
+
+int MeshBufferPool::takeAllocations()
+{
+    return m_allocations.exchange(0);
+}
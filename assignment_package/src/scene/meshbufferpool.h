@@ -0,0 +1,49 @@
+#pragma once
+#include "chunk.h"
+#include <mutex>
+
+// Recycles the vertex and index vectors that Chunks are meshed into.
+// Meshing jobs take empty buffers that are already reserved to the size a
+// Chunk of that biome usually needs, and hand them back once the mesh has
+// been uploaded, so that steady-state meshing does not touch the heap.
+// The expected sizes are running averages of the meshes each biome produced.
+class MeshBufferPool {
+private:
+    // Buffers that have been uploaded and cleared, keeping their capacity.
+    // Opaque buffers are [0] and transparent ones [1], since their sizes differ a lot.
+    std::array<std::vector<std::vector<ChunkVertex>>, 2> m_freeVertices;
+    std::array<std::vector<std::vector<GLuint>>, 2> m_freeIndices;
+
+    // Exponential moving average of the size of each of ChunkVBOData's four
+    // buffers (opaque vertices, opaque indices, transparent vertices,
+    // transparent indices), per biome
+    std::array<std::array<float, 4>, 3> m_expectedSize;
+
+    std::mutex m_mutex;
+
+    // Heap allocations made for mesh buffers since the last takeAllocations()
+    std::atomic_int m_allocations;
+
+    template <typename T>
+    size_t reserveFrom(std::vector<std::vector<T>> &freeList, std::vector<T> &out, size_t size);
+    template <typename T>
+    void giveBack(std::vector<std::vector<T>> &freeList, std::vector<T> &buffer);
+
+public:
+    MeshBufferPool();
+
+    // Puts empty buffers into the four vectors of data, reserved for a mesh of
+    // the given biome, or the given fraction of one. Returns the capacity each one was given.
+    std::array<size_t, 4> acquire(ChunkVBOData &data, BiomeType biome, float fraction = 1.f);
+    // Updates the biome's expected sizes with the finished mesh in data, and
+    // counts the reallocations it needed beyond the reserved capacities
+    void recordMesh(const ChunkVBOData &data, BiomeType biome, const std::array<size_t, 4> &reserved);
+    // Takes back the buffers of data once they are no longer needed
+    void release(ChunkVBOData &data);
+
+    // Returns the number of mesh buffer allocations since the last call
+    int takeAllocations();
+
+    // Number of allocations std::vector makes growing from one capacity to another
+    static int growthAllocations(size_t from, size_t to);
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// A lock-free queue that any number of threads can push to while a single
+// thread takes items out. Producers push onto an intrusive stack with one
+// compare-and-swap; the consumer detaches the whole stack at once with an
+// exchange and reverses it, so items come out in the order they were pushed.
+// Items are moved in and moved out, never copied.
+template <typename T>
+class MPSCQueue {
+private:
+    struct Node
+    {
+        T value;
+        Node* next;
+    };
+
+    std::atomic<Node*> m_head;
+
+public:
+    MPSCQueue() : m_head(nullptr)
+    {}
+
+    ~MPSCQueue()
+    {
+        Node* n = m_head.exchange(nullptr);
+        while (n != nullptr)
+        {
+            Node* next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // Safe to call from any thread
+    void push(T &&value)
+    {
+        Node* n = new Node{std::move(value), m_head.load(std::memory_order_relaxed)};
+        while (!m_head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed))
+        {}
+    }
+
+    // Moves every item pushed so far onto the end of out, oldest first.
+    // Only the consumer thread may call this.
+    void popAll(std::vector<T> &out)
+    {
+        Node* n = m_head.exchange(nullptr, std::memory_order_acquire);
+        // Reverse the stack into push order
+        Node* ordered = nullptr;
+        while (n != nullptr)
+        {
+            Node* next = n->next;
+            n->next = ordered;
+            ordered = n;
+            n = next;
+        }
+        while (ordered != nullptr)
+        {
+            out.push_back(std::move(ordered->value));
+            Node* next = ordered->next;
+            delete ordered;
+            ordered = next;
+        }
+    }
+
+    // Whether anything is waiting. Only a hint, since producers may push at any time.
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_relaxed) == nullptr;
+    }
+};
@@ -83,7 +83,7 @@ void Player::processInputs(InputBundle &inputs) {
 }
 
 // grid marching from the slides
-bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit) {
+bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, TerrainView &view, float *out_dist, glm::ivec3 *out_blockHit) {
     float maxLen = glm::length(rayDirection); // Farthest we search
     glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
     rayDirection = glm::normalize(rayDirection); // Now all t values represent world dist.
@@ -118,14 +118,15 @@ bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terra
         // Sets it to 0 if sign is +, -1 if sign is -
         offset[interfaceAxis] = glm::min(0.f, glm::sign(rayDirection[interfaceAxis]));
         currCell = glm::ivec3(glm::floor(rayOrigin)) + offset;
-        // If currCell contains something other than EMPTY, return
+        // If currCell contains a solid block, return
         // curr_t
-        if (!terrain.hasChunkAt(currCell.x, currCell.z)) {
+        view.moveTo(currCell);
+        BlockType cellType = view.get();
+        if (cellType == UNLOADED_BLOCK) {
             *out_dist = glm::min(maxLen, curr_t);
             return false;
         }
-        BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-        if(cellType != EMPTY && cellType != WATER && cellType != LAVA) {
+        if(blockProperties(cellType).solid) {
             *out_blockHit = currCell;
             *out_dist = glm::min(maxLen, curr_t);
             return true;
@@ -135,6 +136,11 @@ bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terra
     return false;
 }
 
+bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit) {
+    TerrainView view(terrain, glm::ivec3(glm::floor(rayOrigin)));
+    return gridMarch(rayOrigin, rayDirection, view, out_dist, out_blockHit);
+}
+
 // array for points to check in the bounding box of the player, constant for each call
 const std::array<glm::vec3,12> boundingBox = {glm::vec3(BOUNDING_BOX_WIDTH,0,BOUNDING_BOX_WIDTH),
                                                glm::vec3(-1*BOUNDING_BOX_WIDTH,0,BOUNDING_BOX_WIDTH),
@@ -150,7 +156,7 @@ const std::array<glm::vec3,12> boundingBox = {glm::vec3(BOUNDING_BOX_WIDTH,0,BOU
                                                glm::vec3(BOUNDING_BOX_WIDTH,BOUNDING_BOX_HEIGHT,-1*BOUNDING_BOX_WIDTH)};
 
 // collide the player with the terrian using grid marching technique
-void Player::collideAndMove(const Terrain& terrain, float dt) {
+void Player::collideAndMove(TerrainView &view, float dt) {
 
     // loop through axes
     std::array<glm::vec3,3> axisDirections = {glm::vec3(1,0,0), glm::vec3(0,1,0), glm::vec3(0,0,1)};
@@ -163,7 +169,7 @@ void Player::collideAndMove(const Terrain& terrain, float dt) {
             float collisionDist = moveDist;
             glm::ivec3 block;
 
-            gridMarch(point + m_position, m_velocity[i] * dt * axisDirections[i], terrain,&collisionDist, &block);
+            gridMarch(point + m_position, m_velocity[i] * dt * axisDirections[i], view, &collisionDist, &block);
 
             collisionDist = collisionDist - COLLISION_THRESHOLD;
             moveDist = glm::min(moveDist,collisionDist);
@@ -183,19 +189,26 @@ void Player::collideAndMove(const Terrain& terrain, float dt) {
 
 void Player::computePhysics(float dT, const Terrain &terrain) {
 
-    if (terrain.hasChunkAt(m_position.x, m_position.z)) {
+    // The body and camera blocks are read in one go, from the bottom up
+    TerrainView view(terrain, glm::ivec3(this->m_position));
+    int headY = static_cast<int>(this->m_position.y + 1.5f);
+    std::array<BlockType, 3> column;
+    view.read(glm::ivec3(0), glm::ivec3(1, headY - view.getPosition().y + 1, 1), column.data());
+    BlockType body = column[0], head = column[headY - view.getPosition().y];
+
+    if (view.getChunk() != nullptr) {
         //check for in water/lava
-        if (terrain.getBlockAt(this->m_position + glm::vec3(0, 1.5f, 0)) == BlockType::WATER) {
+        if (head == BlockType::WATER) {
             this->inWater = 2;
             this->inLava = 0;
-        } else if (terrain.getBlockAt(this->m_position + glm::vec3(0, 1.5f, 0)) == BlockType::LAVA) {
+        } else if (head == BlockType::LAVA) {
             this->inWater = 0;
             this->inLava = 2;
         } else {
-            if (terrain.getBlockAt(this->m_position) == BlockType::WATER) {
+            if (body == BlockType::WATER) {
                 this->inWater = 1;
                 this->inLava = 0;
-            } else if (terrain.getBlockAt(this->m_position) == BlockType::LAVA) {
+            } else if (body == BlockType::LAVA) {
                 this->inWater = 0;
                 this->inLava = 1;
             } else {
@@ -218,7 +231,7 @@ void Player::computePhysics(float dT, const Terrain &terrain) {
     if (flight) {
         moveAlongVector(m_velocity * dT * FLYING_MUL);
     } else {
-        collideAndMove(terrain, dT);
+        collideAndMove(view, dT);
     }
 
     // decay acceleration and velocity
@@ -231,17 +244,8 @@ void Player::breakBlock(Terrain& terrain) const {
     glm::ivec3 block;
     if (gridMarch(mcr_camera.mcr_position, REACH_DIST * m_forward, terrain, &dist, &block) &&
         terrain.getBlockAt(block.x, block.y, block.z) != BlockType::BEDROCK) {
+        // Terrain re-meshes the affected sections on the threads
         terrain.setBlockAt(block.x,block.y,block.z,EMPTY);
-
-        Chunk* chunkWithBlock = terrain.getChunkAt(block.x,block.z).get();
-        std::array<Chunk*,4> neighborChunkBlocks = {terrain.getChunkAt(block.x - 1,block.z).get(),terrain.getChunkAt(block.x + 1,block.z).get(),terrain.getChunkAt(block.x,block.z - 1).get(),terrain.getChunkAt(block.x,block.z + 1).get()};
-
-        for (Chunk* c : neighborChunkBlocks) {
-            if (c != chunkWithBlock) {
-                c->resetVBOData();
-            }
-        }
-        chunkWithBlock->resetVBOData();
     }
 }
 
@@ -273,7 +277,6 @@ void Player::placeBlock(Terrain& terrain, BlockType placingBlock) const {
 
         // else place
         terrain.setBlockAt(placedBlock.x,placedBlock.y,placedBlock.z,placingBlock);
-        terrain.getChunkAt(placedBlock.x,placedBlock.z)->resetVBOData();
     }
 }
 
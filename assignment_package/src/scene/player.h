@@ -2,6 +2,7 @@
 #include "entity.h"
 #include "camera.h"
 #include "terrain.h"
+#include "terrainview.h"
 
 class Player : public Entity {
 private:
@@ -16,7 +17,7 @@ private:
     bool inAir;
     float phi;
 
-    void collideAndMove(const Terrain& terrain, float dt);
+    void collideAndMove(TerrainView &view, float dt);
 
     int inWater; //0 = no, 1 = body, 2 = camera
     int inLava;
@@ -1,55 +1,42 @@
 #include "terrain.h"
+#include "terrainview.h"
+#include "meshbufferpool.h"
 #include <stack>
 #include <stdexcept>
 #include <iostream>
 #include <thread>
 #include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <map>
 #include <QFile>
 
 #define SDF_R 3.f
 
-Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(), mp_context(context),
-    chunks_needing_generated(), chunks_needing_generated_mutexes(),
-    chunks_needing_created(), chunks_needing_created_mutexes(),
-    created_chunks(), created_chunks_mutex(),
-    threads(),
-    terrain_timer(0.f), prev_pos(glm::vec3()), trees(),
-    saved(), savedMutex(), updated(), savename(),
-    chunks_needing_saving(), chunks_needing_saving_mutexes(), seed(), idle_threads(), terminate(false)
-{
-    for (int i = 0; i < NUM_CORES; i++)
-    {
-        threads.push_back(std::thread(multithread_work,
-                                      std::ref(chunks_needing_generated[i]), std::ref(chunks_needing_generated_mutexes[i]),
-                                      std::ref(chunks_needing_created[(i+1)%NUM_CORES]), std::ref(chunks_needing_created_mutexes[(i+1)%NUM_CORES]),
-                                      std::ref(chunks_needing_saving[(i+2)%NUM_CORES]), std::ref(chunks_needing_saving_mutexes[(i+2)%NUM_CORES]),
-                                      std::ref(this->created_chunks), std::ref(this->created_chunks_mutex),
-                                      std::ref(this->saved), std::ref(this->savedMutex), std::ref(this->savename), std::ref(idle_threads[i]),std::ref(terminate)));
-    }
-}
-
-Terrain::Terrain(OpenGLContext *context, QString savename)
-    : m_chunks(), m_generatedTerrain(), mp_context(context),
-    chunks_needing_generated(), chunks_needing_generated_mutexes(),
-    chunks_needing_created(), chunks_needing_created_mutexes(),
-    created_chunks(), created_chunks_mutex(),
-    threads(),
-    terrain_timer(0.f), prev_pos(glm::vec3()),
-    saved(), savedMutex(), updated(), savename(savename),
-    chunks_needing_saving(), chunks_needing_saving_mutexes(), seed(), idle_threads(), terminate(false)
+Terrain::Terrain(OpenGLContext *context, const TerrainGen &gen)
+    : m_chunks(), chunk_grid(), m_generatedTerrain(), zone_last_used(), expansion_count(0), active_zones(),
+    block_memory_budget(BLOCK_MEMORY_BUDGET), block_bytes(0), unloaded_zones(0), storage_stats(),
+    compressed_chunks(), thaw_queue(), generation_events(), pending_generation_events(), mp_context(context),
+    created_chunks(),
+    upload_backlog(), upload_budget_ms(UPLOAD_BUDGET_MS), upload_budget_bytes(UPLOAD_BUDGET_BYTES), mesh_allocations(0),
+    terrain_timer(0.f), prev_pos(glm::vec3()), focus_pos(), focus_forward(0, 0, -1), trees(),
+    saved(), savedMutex(), updated(), savename(), seed(), terrain_gen(gen), zone_fields(), generation_pipeline(GenerationPipeline::defaultPipeline()),
+    cancelled_generations(0), cancelled_meshes(0), discarded_vbo_data(0),
+    jobs(NUM_CORES, [this](const ChunkJob &job) { doJob(job); })
+{}
+
+Terrain::Terrain(OpenGLContext *context, QString savename, const TerrainGen &gen)
+    : m_chunks(), chunk_grid(), m_generatedTerrain(), zone_last_used(), expansion_count(0), active_zones(),
+    block_memory_budget(BLOCK_MEMORY_BUDGET), block_bytes(0), unloaded_zones(0), storage_stats(),
+    compressed_chunks(), thaw_queue(), generation_events(), pending_generation_events(), mp_context(context),
+    created_chunks(),
+    upload_backlog(), upload_budget_ms(UPLOAD_BUDGET_MS), upload_budget_bytes(UPLOAD_BUDGET_BYTES), mesh_allocations(0),
+    terrain_timer(0.f), prev_pos(glm::vec3()), focus_pos(), focus_forward(0, 0, -1), trees(),
+    saved(), savedMutex(), updated(), savename(savename), seed(), terrain_gen(gen), zone_fields(), generation_pipeline(GenerationPipeline::defaultPipeline()),
+    cancelled_generations(0), cancelled_meshes(0), discarded_vbo_data(0),
+    jobs(NUM_CORES, [this](const ChunkJob &job) { doJob(job); })
 {
     load(savename);
-
-    for (int i = 0; i < NUM_CORES; i++)
-    {
-        threads.push_back(std::thread(multithread_work,
-                                      std::ref(chunks_needing_generated[i]), std::ref(chunks_needing_generated_mutexes[i]),
-                                      std::ref(chunks_needing_created[(i+1)%NUM_CORES]), std::ref(chunks_needing_created_mutexes[(i+1)%NUM_CORES]),
-                                      std::ref(chunks_needing_saving[(i+2)%NUM_CORES]), std::ref(chunks_needing_saving_mutexes[(i+2)%NUM_CORES]),
-                                      std::ref(this->created_chunks), std::ref(this->created_chunks_mutex),
-                                      std::ref(this->saved), std::ref(this->savedMutex), std::ref(this->savename), std::ref(idle_threads[i]),std::ref(terminate)));
-    }
 }
 
 Terrain::~Terrain() {
@@ -57,11 +44,7 @@ Terrain::~Terrain() {
     {
         m_chunks[key]->destroyVBOData();
     }
-
-    terminate.store(true);
-    for (int i = 0; i < NUM_CORES; i++) {
-        threads[i].join();
-    }
+    // jobs finishes any queued saves as it is destroyed
 }
 
 // Array containing ivec2's representing the translation distance to each of the surrounding
@@ -108,17 +91,18 @@ glm::ivec2 toCoords(int64_t k) {
 // the coordinates at x, y, z have a corresponding Chunk
 BlockType Terrain::getBlockAt(int x, int y, int z) const
 {
-    if(hasChunkAt(x, z)) {
+    Chunk* c = findGeneratedChunk(x, z);
+    if(c) {
         // Just disallow action below or above min/max height,
         // but don't crash the game over it.
         if(y < 0 || y >= 256) {
             return EMPTY;
         }
-        const uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        return c->getBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
+        // The low 4 bits are the position within the Chunk,
+        // negative coordinates included
+        return c->getBlockAt(static_cast<unsigned int>(x & 15),
                              static_cast<unsigned int>(y),
-                             static_cast<unsigned int>(z - chunkOrigin.y));
+                             static_cast<unsigned int>(z & 15));
     }
     else {
         throw std::out_of_range("Coordinates " + std::to_string(x) +
@@ -131,42 +115,109 @@ BlockType Terrain::getBlockAt(glm::vec3 p) const {
     return getBlockAt(p.x, p.y, p.z);
 }
 
-bool Terrain::hasChunkAt(int x, int z) const {
-    // Map x and z to their nearest Chunk corner
-    // By flooring x and z, then multiplying by 16,
-    // we clamp (x, z) to its nearest Chunk-space corner,
-    // then scale back to a world-space location.
-    // Note that floor() lets us handle negative numbers
-    // correctly, as floor(-1 / 16.f) gives us -1, as
-    // opposed to (int)(-1 / 16.f) giving us 0 (incorrect!).
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.find(toKey(16 * xFloor, 16 * zFloor)) != m_chunks.end();
+int Terrain::getHeightAt(HeightmapType type, int x, int z) const
+{
+    const Chunk* c = findChunk(x, z);
+    if (!c || !c->isGenerated())
+    {
+        return -1;
+    }
+    return c->getHeightAt(type, x & 15, z & 15);
 }
 
-uPtr<Chunk>& Terrain::getChunkAt(int x, int z) {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks[toKey(16 * xFloor, 16 * zFloor)];
+bool Terrain::getZoneHeightmap(HeightmapType type, int x, int z, std::array<int16_t, 4096> &out) const
+{
+    // Rounds toward negative infinity like the shifts in findChunk
+    int zoneX = 64 * (x >> 6), zoneZ = 64 * (z >> 6);
+    std::array<const Chunk*, 16> chunks;
+    for (int i = 0; i < 16; i++)
+    {
+        int cx = zoneX + 16 * (i % 4), cz = zoneZ + 16 * (i / 4);
+        chunks[i] = findChunk(cx, cz);
+        if (!chunks[i] || !chunks[i]->isGenerated())
+        {
+            return false;
+        }
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        const std::array<int16_t, 256> &heights = chunks[i]->getHeightmap(type);
+        int16_t* dst = &out[16 * (i % 4) + 64 * 16 * (i / 4)];
+        for (int cz = 0; cz < 16; cz++)
+        {
+            std::copy_n(&heights[16 * cz], 16, dst + 64 * cz);
+        }
+    }
+    return true;
 }
 
+Chunk* Terrain::findChunk(int x, int z) const {
+    // Shifting right by 4 maps x and z to the corner of their Chunk in
+    // Chunk space. Unlike (int)(x / 16), the arithmetic shift rounds
+    // toward negative infinity, so -1 >> 4 gives us -1 as it should.
+    int cx = x >> 4, cz = z >> 4;
+    if (chunk_grid.contains(cx, cz)) {
+        return chunk_grid.get(cx, cz);
+    }
+    auto it = m_chunks.find(toKey(16 * cx, 16 * cz));
+    return it == m_chunks.end() ? nullptr : it->second.get();
+}
+Chunk* Terrain::findGeneratedChunk(int x, int z) const {
+    Chunk* c = findChunk(x, z);
+    return (c != nullptr && c->isGenerated()) ? c : nullptr;
+}
+bool Terrain::hasChunkAt(int x, int z) const {
+    return findGeneratedChunk(x, z) != nullptr;
+}
+uPtr<Chunk>& Terrain::getChunkAt(int x, int z) {
+    return m_chunks[toKey(16 * (x >> 4), 16 * (z >> 4))];
+}
 const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.at(toKey(16 * xFloor, 16 * zFloor));
+    return m_chunks.at(toKey(16 * (x >> 4), 16 * (z >> 4)));
 }
 
 void Terrain::setBlockAt(int x, int y, int z, BlockType t)
 {
-    if(hasChunkAt(x, z)) {
-        uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        c->setBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
+    // An edit to a Chunk still being generated would be overwritten
+    Chunk* c = findGeneratedChunk(x, z);
+    if(c) {
+        int localX = x & 15, localZ = z & 15;
+        c->setBlockAt(static_cast<unsigned int>(localX),
                       static_cast<unsigned int>(y),
-                      static_cast<unsigned int>(z - chunkOrigin.y),
+                      static_cast<unsigned int>(localZ),
                       t);
 
-        updated.insert(c.get());
+        updated.insert(c);
+
+        // A block on a section's border can also hide or reveal
+        // faces of the block next to it in the neighboring section
+        int section = y >> 4;
+        markSectionDirty(c, section);
+        if ((y & 15) == 0 && section > 0)
+        {
+            markSectionDirty(c, section - 1);
+        }
+        if ((y & 15) == 15 && section < 15)
+        {
+            markSectionDirty(c, section + 1);
+        }
+        std::unordered_map<Direction, Chunk*, EnumHash> &neighbors = c->getNeighbors();
+        if (localX == 0 && neighbors[XNEG] != nullptr)
+        {
+            markSectionDirty(neighbors[XNEG], section);
+        }
+        if (localX == 15 && neighbors[XPOS] != nullptr)
+        {
+            markSectionDirty(neighbors[XPOS], section);
+        }
+        if (localZ == 0 && neighbors[ZNEG] != nullptr)
+        {
+            markSectionDirty(neighbors[ZNEG], section);
+        }
+        if (localZ == 15 && neighbors[ZPOS] != nullptr)
+        {
+            markSectionDirty(neighbors[ZPOS], section);
+        }
     }
     else {
         throw std::out_of_range("Coordinates " + std::to_string(x) +
@@ -175,24 +226,55 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
     }
 }
 
+void Terrain::markSectionDirty(Chunk *c, int section)
+{
+    c->bumpSectionVersion(section);
+    c->tryTransition(UPLOADED, DIRTY);
+    dirty_sections[c] |= 1 << section;
+}
+
+void Terrain::remeshDirtySections()
+{
+    for (auto &d : dirty_sections)
+    {
+        // Chunks without an uploaded mesh pick up the edit when they are
+        // meshed in full, or when their pending full mesh is uploaded
+        if (d.first->getState() != UPLOADED && d.first->getState() != DIRTY)
+        {
+            continue;
+        }
+        for (int section = 0; section < 16; section++)
+        {
+            if (d.second & (1 << section))
+            {
+                ChunkJob job{SECTION_MESH_JOB, d.first};
+                job.section = section;
+                jobs.push(job);
+            }
+        }
+    }
+    dirty_sections.clear();
+}
+
 Chunk* Terrain::instantiateChunkAt(int x, int z) {
     uPtr<Chunk> chunk = mkU<Chunk>(this->mp_context, x, z, toKey(x,z));
     Chunk *cPtr = chunk.get();
     m_chunks[toKey(x, z)] = std::move(chunk);
+    chunk_grid.set(x >> 4, z >> 4, cPtr);
     // Set the neighbor pointers of itself and its neighbors
-    if(hasChunkAt(x, z + 16)) {
+    if(findChunk(x, z + 16)) {
         auto &chunkNorth = m_chunks[toKey(x, z + 16)];
         cPtr->linkNeighbor(chunkNorth, ZPOS);
     }
-    if(hasChunkAt(x, z - 16)) {
+    if(findChunk(x, z - 16)) {
         auto &chunkSouth = m_chunks[toKey(x, z - 16)];
         cPtr->linkNeighbor(chunkSouth, ZNEG);
     }
-    if(hasChunkAt(x + 16, z)) {
+    if(findChunk(x + 16, z)) {
         auto &chunkEast = m_chunks[toKey(x + 16, z)];
         cPtr->linkNeighbor(chunkEast, XPOS);
     }
-    if(hasChunkAt(x - 16, z)) {
+    if(findChunk(x - 16, z)) {
         auto &chunkWest = m_chunks[toKey(x - 16, z)];
         cPtr->linkNeighbor(chunkWest, XNEG);
     }
@@ -208,12 +290,13 @@ void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shader
         {
             for (int z = minZ; z < maxZ; z += 16)
             {
-                if (hasChunkAt(x, z))
+                if (findChunk(x, z))
                 {
                     const uPtr<Chunk> &chunk = getChunkAt(x, z);
                     if (chunk->hasVBOData())
                     {
-                        //shaderProgram->setModelMatrix(glm::translate(glm::mat4(), glm::vec3(x, 0, z)));
+                        // Chunk vertices are stored relative to the chunk's corner
+                        shaderProgram->setChunkOrigin(chunk->getMinPos());
                         shaderProgram->drawInterleaved((opaque) ? chunk->opaque : chunk->transparent);
                     }
                 }
@@ -222,8 +305,33 @@ void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shader
     }
 }
 
-void Terrain::tick(const glm::vec3 &player_pos, float dt)
+void Terrain::tick(const glm::vec3 &player_pos, const glm::vec3 &player_forward, float dt)
 {
+    // Re-sort the queued jobs once the player has moved or turned far enough
+    // for the chunks they will see next to have changed
+    if (glm::distance(player_pos, focus_pos) > 8.f || glm::dot(player_forward, focus_forward) < 0.9f)
+    {
+        focus_pos = player_pos;
+        focus_forward = player_forward;
+        jobs.setFocus(focus_pos, focus_forward);
+    }
+
+    // Keep the player at the centre of chunk_grid
+    glm::ivec2 playerChunk(static_cast<int>(glm::floor(player_pos.x)) >> 4,
+                           static_cast<int>(glm::floor(player_pos.z)) >> 4);
+    if (playerChunk != chunk_grid.getCentre())
+    {
+        chunk_grid.recentre(playerChunk, m_chunks);
+    }
+
+    // Meshes are uploaded every frame, a few at a time
+    handleGenerationEvents();
+    remeshDirtySections();
+    uploadChunks(player_pos);
+    freezeCompressedChunks();
+    thawChunks();
+    mesh_allocations = Chunk::getBufferPool().takeAllocations();
+
     terrain_timer += dt;
     if (terrain_timer < 1.f)
     {
@@ -231,25 +339,150 @@ void Terrain::tick(const glm::vec3 &player_pos, float dt)
     }
     tryExpansion(player_pos, this->prev_pos);
 
-    // Send VBO data to the GPU in main thread
-    created_chunks_mutex.lock();
-    for (auto &d : created_chunks)
+    // set timer back to 0 and set prev_pos if we reach this point
+    terrain_timer = 0;
+    this->prev_pos = player_pos;
+}
+
+// Bytes of GPU memory the VBO data will take up once uploaded
+static size_t uploadBytes(const ChunkVBOData &d)
+{
+    return (d.vboDataOpaque.size() + d.vboDataTransparent.size()) * sizeof(ChunkVertex)
+           + (d.idxDataOpaque.size() + d.idxDataTransparent.size()) * sizeof(GLuint);
+}
+
+void Terrain::collectFinishedMeshes()
+{
+    std::vector<ChunkVBOData> finished;
+    created_chunks.popAll(finished);
+
+    // A chunk (or one of its sections) may have been meshed again while its
+    // older mesh was still waiting here, in which case only the newest one matters
+    if (!finished.empty())
+    {
+        std::map<std::pair<Chunk*, int>, size_t> backlogIdx;
+        for (size_t i = 0; i < upload_backlog.size(); i++)
+        {
+            backlogIdx[{upload_backlog[i].chunk, upload_backlog[i].section}] = i;
+        }
+        for (ChunkVBOData &d : finished)
+        {
+            auto it = backlogIdx.find({d.chunk, d.section});
+            if (it != backlogIdx.end())
+            {
+                Chunk::releaseVBOData(upload_backlog[it->second]);
+                upload_backlog[it->second] = std::move(d);
+            }
+            else
+            {
+                backlogIdx[{d.chunk, d.section}] = upload_backlog.size();
+                upload_backlog.push_back(std::move(d));
+            }
+        }
+    }
+}
+
+void Terrain::uploadChunks(const glm::vec3 &player_pos)
+{
+    // Collect what the workers have finished
+    collectFinishedMeshes();
+    if (upload_backlog.empty())
     {
-        d.chunk->create(d.vboDataOpaque, d.idxDataOpaque,
-                        d.vboDataTransparent, d.idxDataTransparent);
+        return;
+    }
+
+    // Farthest first, so the nearest chunk is at the back
+    glm::vec2 player_xz(player_pos.x, player_pos.z);
+    std::sort(upload_backlog.begin(), upload_backlog.end(),
+              [&player_xz](const ChunkVBOData &a, const ChunkVBOData &b) {
+        return glm::distance(glm::vec2(a.chunk->getMinPos()) + 8.f, player_xz) >
+               glm::distance(glm::vec2(b.chunk->getMinPos()) + 8.f, player_xz);
+    });
+
+    // Send VBO data to the GPU in main thread until the frame's budget is spent.
+    // At least one chunk goes up every frame so that large meshes still make progress.
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    while (!upload_backlog.empty())
+    {
+        ChunkVBOData &d = upload_backlog.back();
+        // The chunk was unloaded after it was meshed
+        if (d.epoch != d.chunk->getEpoch())
+        {
+            Chunk::releaseVBOData(d);
+            discarded_vbo_data++;
+            upload_backlog.pop_back();
+            continue;
+        }
+        float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (bytes > 0 && (elapsed >= upload_budget_ms || bytes + uploadBytes(d) > upload_budget_bytes))
+        {
+            break;
+        }
+        bytes += uploadBytes(d);
+
+        if (d.section != -1)
+        {
+            // Only the mesh of the latest edit goes up, and only into a
+            // chunk that still has the rest of its mesh uploaded
+            if (d.chunk->hasVBOData() && d.versions[d.section] == d.chunk->getSectionVersion(d.section))
+            {
+                if (!d.chunk->updateSection(d))
+                {
+                    // The section outgrew its slot, so lay the whole chunk out again
+                    if (d.chunk->requestRemesh())
+                    {
+                        jobs.push({MESH_JOB, d.chunk});
+                    }
+                }
+                else if (d.chunk->meshUpToDate())
+                {
+                    d.chunk->tryTransition(DIRTY, UPLOADED);
+                }
+            }
+            Chunk::releaseVBOData(d);
+            upload_backlog.pop_back();
+            continue;
+        }
+
+        // Chunks being re-meshed still hold the buffers of their old mesh
+        if (d.chunk->hasVBOData())
+        {
+            d.chunk->destroyVBOData();
+        }
+        d.chunk->create(d);
+        // Re-mesh the sections that were edited while the chunk was being meshed
+        for (int section = 0; section < 16; section++)
+        {
+            if (d.versions[section] != d.chunk->getSectionVersion(section))
+            {
+                ChunkJob job{SECTION_MESH_JOB, d.chunk};
+                job.section = section;
+                jobs.push(job);
+            }
+        }
+        // Unless it was sent to be meshed in full again in the meantime
+        d.chunk->tryTransition(MESHED, d.chunk->meshUpToDate() ? UPLOADED : DIRTY);
+        Chunk::releaseVBOData(d);
         //get the chunks trees
         std::vector<glm::ivec4> currChunkTrees = d.chunk->getTrees();
+        d.chunk->clearTrees();
+        upload_backlog.pop_back();
         for (auto& t : currChunkTrees) {
             this->createTree(t);
         }
-        d.chunk->clearTrees();
     }
-    created_chunks.clear();
-    created_chunks_mutex.unlock();
+}
 
-    // set timer back to 0 and set prev_pos if we reach this point
-    terrain_timer = 0;
-    this->prev_pos = player_pos;
+void Terrain::setUploadBudget(float ms, size_t bytes)
+{
+    upload_budget_ms = ms;
+    upload_budget_bytes = bytes;
+}
+
+size_t Terrain::getUploadBacklog() const
+{
+    return upload_backlog.size();
 }
 
 void Terrain::tryExpansion(const glm::vec3 &player_pos, const glm::vec3 &prev_pos)
@@ -269,6 +502,13 @@ void Terrain::tryExpansion(const glm::vec3 &player_pos, const glm::vec3 &prev_po
         }
     }
 
+    expansion_count++;
+    for (int64_t key : curr_rad)
+    {
+        zone_last_used[key] = expansion_count;
+    }
+    active_zones = curr_rad;
+
     // Delete VBO data for old terrain, i.e., keys found in PREV and not CURR
     for (int64_t key : prev_rad)
     {
@@ -283,7 +523,6 @@ void Terrain::tryExpansion(const glm::vec3 &player_pos, const glm::vec3 &prev_po
     for (int64_t key : curr_rad)
     {
         glm::ivec2 coords = toCoords(key);
-        int i = 0;
         if (m_generatedTerrain.find(key) == m_generatedTerrain.end())
         {
             // Send chunk data to threads to be processed for blocktype data
@@ -292,33 +531,42 @@ void Terrain::tryExpansion(const glm::vec3 &player_pos, const glm::vec3 &prev_po
                 for (int z = coords.y; z < coords.y + 64; z += 16)
                 {
                     Chunk* c = instantiateChunkAt(x, z);
-                    chunks_needing_generated_mutexes[i].lock();
-                    chunks_needing_generated[i].push_back(c);
-                    chunks_needing_generated_mutexes[i].unlock();
-                    i = (i + 1) % NUM_CORES;
+                    c->setState(GENERATING);
+                    jobs.push({GENERATE_JOB, c});
                 }
             }
             m_generatedTerrain.insert(key);
         }
-        else
+        else if (prev_rad.find(key) == prev_rad.end())
         {
-            // Send chunk data to threads to be processed for vbo data
+            // The zone came back within CREATE_RADIUS. Chunks that were left
+            // waiting on a neighbor are meshed when the neighbor's generation
+            // finishes, so only the zones that just came back are looked at.
             for (int x = coords.x; x < coords.x + 64; x += 16)
             {
                 for (int z = coords.y; z < coords.y + 64; z += 16)
                 {
                     Chunk* c = getChunkAt(x, z).get();
-                    if (c && c->canCreate() /*&& prev_rad.find(key) == prev_rad.end()*/)
+                    if (c->isCold())
                     {
-                        chunks_needing_created_mutexes[i].lock();
-                        chunks_needing_created[i].push_back(c);
-                        chunks_needing_created_mutexes[i].unlock();
-                        i = (i + 1) % NUM_CORES;
+                        thaw_queue.push_back(c);
+                    }
+                    // Its generation was cancelled when it left
+                    if (c->tryTransition(ALLOCATED, GENERATING))
+                    {
+                        jobs.push({GENERATE_JOB, c});
+                    }
+                    else
+                    {
+                        queueMesh(c);
                     }
                 }
             }
         }
     }
+
+    updateStorageTiers();
+    unloadZones(curr_rad);
 }
 
 void Terrain::deleteTerrain(int64_t &key)
@@ -329,6 +577,8 @@ void Terrain::deleteTerrain(int64_t &key)
         for (int z = coords.y; z < coords.y + 64; z += 16)
         {
             Chunk* c = getChunkAt(x, z).get();
+            // Cancel the chunk's queued jobs and any VBO data not yet uploaded
+            c->bumpEpoch();
             if (c->hasVBOData())
             {
                 c->destroyVBOData();
@@ -337,6 +587,306 @@ void Terrain::deleteTerrain(int64_t &key)
     }
 }
 
+// Key of the terrain generation zone that contains the Chunk with the given corner
+static int64_t zoneKeyOf(glm::ivec2 chunkPos)
+{
+    return toKey(64 * (chunkPos.x >> 6), 64 * (chunkPos.y >> 6));
+}
+
+bool Terrain::isActive(const Chunk* c) const
+{
+    return active_zones.find(zoneKeyOf(c->getMinPos())) != active_zones.end();
+}
+
+void Terrain::queueMesh(Chunk* c)
+{
+    if (isActive(c) && c->getState() == GENERATED && c->neighborsGenerated() && c->tryTransition(GENERATED, MESHING))
+    {
+        jobs.push({MESH_JOB, c});
+    }
+}
+
+void Terrain::handleGenerationEvents()
+{
+    generation_events.popAll(pending_generation_events);
+    for (Chunk* c : pending_generation_events)
+    {
+        if (c->getState() == ALLOCATED)
+        {
+            // It came back within CREATE_RADIUS before its cancelled job ran
+            if (isActive(c) && c->tryTransition(ALLOCATED, GENERATING))
+            {
+                jobs.push({GENERATE_JOB, c});
+            }
+            continue;
+        }
+        // This may have been the last of a neighbor's neighbors to be generated
+        queueMesh(c);
+        for (auto &n : c->getNeighbors())
+        {
+            if (n.second != nullptr)
+            {
+                queueMesh(n.second);
+            }
+        }
+    }
+    pending_generation_events.clear();
+}
+
+void Terrain::freezeCompressedChunks()
+{
+    std::vector<ColdChunkData> compressed;
+    compressed_chunks.popAll(compressed);
+    for (ColdChunkData &d : compressed)
+    {
+        size_t hotBytes = d.chunk->blockBytes();
+        size_t coldBytes = d.blocks.residentBytes();
+        bool active = active_zones.find(zoneKeyOf(d.chunk->getMinPos())) != active_zones.end();
+        if (active)
+        {
+            d.chunk->cancelCompression();
+        }
+        else if (d.chunk->freeze(std::move(d.blocks), d.version))
+        {
+            storage_stats.compressedFrom += hotBytes;
+            storage_stats.compressedTo += coldBytes;
+        }
+    }
+}
+
+void Terrain::thawChunks()
+{
+    for (int i = 0; i < THAW_CHUNKS_PER_FRAME && !thaw_queue.empty(); i++)
+    {
+        Chunk* c = thaw_queue.back();
+        thaw_queue.pop_back();
+        // It may have left CREATE_RADIUS again, or been thawed by an edit
+        if (c->isCold() && active_zones.find(zoneKeyOf(c->getMinPos())) != active_zones.end())
+        {
+            c->thaw();
+        }
+    }
+}
+
+void Terrain::updateStorageTiers()
+{
+    // Zones within CREATE_RADIUS were thawed as tryExpansion went over them
+    for (int64_t key : m_generatedTerrain)
+    {
+        bool active = active_zones.find(key) != active_zones.end();
+        glm::ivec2 coords = toCoords(key);
+        for (int x = coords.x; x < coords.x + 64; x += 16)
+        {
+            for (int z = coords.y; z < coords.y + 64; z += 16)
+            {
+                Chunk* c = getChunkAt(x, z).get();
+                if (!active && c->requestCompression())
+                {
+                    jobs.push({COMPRESS_JOB, c});
+                }
+            }
+        }
+    }
+
+    // Workers only write a Chunk's blocks before it is generated,
+    // so generated Chunks can be measured here without locking them
+    storage_stats.hotChunks = storage_stats.coldChunks = 0;
+    storage_stats.hotBytes = storage_stats.coldBytes = 0;
+    for (auto &c : m_chunks)
+    {
+        if (!c.second->isGenerated())
+        {
+            continue;
+        }
+        if (c.second->isCold())
+        {
+            storage_stats.coldChunks++;
+            storage_stats.coldBytes += c.second->blockBytes();
+        }
+        else
+        {
+            storage_stats.hotChunks++;
+            storage_stats.hotBytes += c.second->blockBytes();
+        }
+    }
+    block_bytes = storage_stats.hotBytes + storage_stats.coldBytes;
+}
+
+void Terrain::unloadZones(const std::unordered_set<int64_t> &active)
+{
+    if (block_bytes <= block_memory_budget)
+    {
+        return;
+    }
+
+    std::vector<int64_t> candidates;
+    for (int64_t key : m_generatedTerrain)
+    {
+        if (active.find(key) == active.end())
+        {
+            candidates.push_back(key);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](int64_t a, int64_t b) {
+        return zone_last_used[a] < zone_last_used[b];
+    });
+
+    // Zones that are still saving or in use by a job are skipped until a later tick
+    std::vector<int64_t> ready;
+    size_t freed = 0;
+    for (int64_t key : candidates)
+    {
+        if (block_bytes - freed <= block_memory_budget)
+        {
+            break;
+        }
+        if (prepareZoneUnload(key))
+        {
+            ready.push_back(key);
+            glm::ivec2 coords = toCoords(key);
+            for (int x = coords.x; x < coords.x + 64; x += 16)
+            {
+                for (int z = coords.y; z < coords.y + 64; z += 16)
+                {
+                    const Chunk* c = getChunkAt(x, z).get();
+                    freed += c->isGenerated() ? c->blockBytes() : 0;
+                }
+            }
+        }
+    }
+    if (ready.empty())
+    {
+        return;
+    }
+
+    // The jobs of these Chunks are done, so every mesh or cold copy
+    // they made is in created_chunks or compressed_chunks by now
+    collectFinishedMeshes();
+    freezeCompressedChunks();
+    generation_events.popAll(pending_generation_events);
+    for (int64_t key : ready)
+    {
+        block_bytes -= unloadZone(key);
+    }
+}
+
+bool Terrain::prepareZoneUnload(int64_t key)
+{
+    bool ready = true;
+    glm::ivec2 coords = toCoords(key);
+    for (int x = coords.x; x < coords.x + 64; x += 16)
+    {
+        for (int z = coords.y; z < coords.y + 64; z += 16)
+        {
+            Chunk* c = getChunkAt(x, z).get();
+            if (updated.erase(c) > 0)
+            {
+                // Loaded from the save file instead of regenerated when the zone comes back
+                savedMutex.lock();
+                saved.insert(c->getKey());
+                savedMutex.unlock();
+                jobs.push({SAVE_JOB, c});
+                ready = false;
+            }
+            // Neighbors' meshing jobs read this Chunk's blocks too
+            if (c->hasQueuedJobs())
+            {
+                ready = false;
+            }
+            for (auto &n : c->getNeighbors())
+            {
+                if (n.second != nullptr && n.second->hasQueuedJobs())
+                {
+                    ready = false;
+                }
+            }
+        }
+    }
+    return ready;
+}
+
+size_t Terrain::unloadZone(int64_t key)
+{
+    std::unordered_set<Chunk*> unloaded;
+    size_t bytes = 0;
+    glm::ivec2 coords = toCoords(key);
+    for (int x = coords.x; x < coords.x + 64; x += 16)
+    {
+        for (int z = coords.y; z < coords.y + 64; z += 16)
+        {
+            Chunk* c = getChunkAt(x, z).get();
+            unloaded.insert(c);
+            bytes += c->isGenerated() ? c->blockBytes() : 0;
+            if (c->hasVBOData())
+            {
+                c->destroyVBOData();
+            }
+            c->bumpEpoch();
+            c->setState(EVICTING);
+            c->unlinkNeighbors();
+            dirty_sections.erase(c);
+        }
+    }
+
+    // Drop the meshes that were finished but never uploaded
+    std::vector<ChunkVBOData> kept;
+    for (ChunkVBOData &d : upload_backlog)
+    {
+        if (unloaded.find(d.chunk) != unloaded.end())
+        {
+            Chunk::releaseVBOData(d);
+        }
+        else
+        {
+            kept.push_back(std::move(d));
+        }
+    }
+    upload_backlog = std::move(kept);
+    thaw_queue.erase(std::remove_if(thaw_queue.begin(), thaw_queue.end(), [&unloaded](Chunk* c) {
+        return unloaded.find(c) != unloaded.end();
+    }), thaw_queue.end());
+    pending_generation_events.erase(std::remove_if(pending_generation_events.begin(), pending_generation_events.end(), [&unloaded](Chunk* c) {
+        return unloaded.find(c) != unloaded.end();
+    }), pending_generation_events.end());
+
+    for (Chunk* c : unloaded)
+    {
+        glm::ivec2 minPos = c->getMinPos();
+        chunk_grid.set(minPos.x >> 4, minPos.y >> 4, nullptr);
+        m_chunks.erase(c->getKey());
+    }
+    m_generatedTerrain.erase(key);
+    zone_last_used.erase(key);
+    zone_fields.erase(coords);
+    unloaded_zones++;
+    return bytes;
+}
+
+void Terrain::setMeshingMode(MeshingMode mode)
+{
+    if (mode == Chunk::getMeshingMode())
+    {
+        return;
+    }
+    Chunk::setMeshingMode(mode);
+
+    for (int64_t key : m_generatedTerrain)
+    {
+        glm::ivec2 coords = toCoords(key);
+        for (int x = coords.x; x < coords.x + 64; x += 16)
+        {
+            for (int z = coords.y; z < coords.y + 64; z += 16)
+            {
+                Chunk* c = getChunkAt(x, z).get();
+                if (c->requestRemesh())
+                {
+                    jobs.push({MESH_JOB, c});
+                }
+            }
+        }
+    }
+}
+
 void Terrain::createTerrain() {}
 
 void Terrain::createTree(glm::ivec4& pos) {
@@ -407,7 +957,9 @@ void Terrain::buildTree(glm::ivec4& pos, std::vector<TreeSymbol>& axiom) {
     std::stack<Turtle> turtleStack;
     float length = 2;
     //chunk -> {logs, leaves} map
-    std::unordered_map<Chunk*, std::pair<std::vector<glm::ivec4>, std::vector<glm::ivec4>>, single_hash> buildMap;
+    std::unordered_map<const Chunk*, std::pair<std::vector<glm::ivec4>, std::vector<glm::ivec4>>, single_hash> buildMap;
+    // The blocks of a tree are close together, so one cursor resolves their Chunks
+    TerrainView view(*this, glm::ivec3(pos));
     
     for (TreeSymbol& symbol : axiom) {
         glm::vec4& tempPos = turtle.pos;
@@ -418,13 +970,10 @@ void Terrain::buildTree(glm::ivec4& pos, std::vector<TreeSymbol>& axiom) {
             for (auto& ref : getBlocks(glm::vec3(tempPos), glm::vec3(tempPos + glm::vec4(0, length, 0, 1) *
                                                                       (glm::rotate(glm::mat4(1.f), glm::radians(tempX), glm::vec3(0, 0, 1))) *
                                                                                           glm::rotate(glm::mat4(1.f), glm::radians(tempZ), glm::vec3(1, 0, 0))))) {
-                if (!this->hasChunkAt(ref.x, ref.z)) return;
+                view.moveTo(glm::ivec3(ref));
+                if (view.getChunk() == nullptr) return;
 
-                if (buildMap.find(this->getChunkAt(ref.x, ref.z).get()) == buildMap.end()) {
-                    buildMap.insert({this->getChunkAt(ref.x, ref.z).get(), {{ref}, {}}});
-                } else {
-                    buildMap.at(this->getChunkAt(ref.x, ref.z).get()).first.push_back(ref);
-                }
+                buildMap[view.getChunk()].first.push_back(ref);
             }
             tempPos += glm::vec4(0.f, length, 0.f, 1.f) *
                                                (glm::rotate(glm::mat4(1.f), glm::radians(tempX), glm::vec3(0.f, 0.f, 1.f))) *
@@ -433,13 +982,10 @@ void Terrain::buildTree(glm::ivec4& pos, std::vector<TreeSymbol>& axiom) {
         case TB:
 
             for (auto& ref : getBlocks(glm::vec3(tempPos), glm::vec3(tempPos) + glm::vec3(0, 1, 0))) {
-                if (!this->hasChunkAt(ref.x, ref.z)) return;
+                view.moveTo(glm::ivec3(ref));
+                if (view.getChunk() == nullptr) return;
 
-                if (buildMap.find(this->getChunkAt(ref.x, ref.z).get()) == buildMap.end()) {
-                    buildMap.insert({this->getChunkAt(ref.x, ref.z).get(), {{ref}, {}}});
-                } else {
-                    buildMap.at(this->getChunkAt(ref.x, ref.z).get()).first.push_back(ref);
-                }
+                buildMap[view.getChunk()].first.push_back(ref);
             }
             tempPos += glm::vec4(0.f, 1.f, 0.f, 0.f);
             break;
@@ -464,13 +1010,10 @@ void Terrain::buildTree(glm::ivec4& pos, std::vector<TreeSymbol>& axiom) {
                     for (int z = -3; z < 4; z++) {
                         glm::vec4 curr = tempPos + glm::vec4(x, y, z, 0);
                         if (sdSphere(glm::vec3(x, y, z), 3.f) < 0.f) {
-                            if (!this->hasChunkAt(curr.x, curr.z)) return;
+                            view.moveTo(glm::ivec3(curr));
+                            if (view.getChunk() == nullptr) return;
 
-                            if (buildMap.find(this->getChunkAt(curr.x, curr.z).get()) == buildMap.end()) {
-                                buildMap.insert({this->getChunkAt(curr.x, curr.z).get(), {{}, {glm::ivec4(curr)}}});
-                            } else {
-                                buildMap.at(this->getChunkAt(curr.x, curr.z).get()).second.push_back(glm::ivec4(curr));
-                            }
+                            buildMap[view.getChunk()].second.push_back(glm::ivec4(curr));
                         }
                     }
                 }
@@ -504,103 +1047,107 @@ void Terrain::buildTree(glm::ivec4& pos, std::vector<TreeSymbol>& axiom) {
         for (auto& leaf : x.second.second) {
             this->setBlockAt(leaf.x, leaf.y, leaf.z, OAK_LEAVES);
         }
-        x.first->resetVBOData();
     }
 }
 
-void multithread_work(std::vector<Chunk*>& chunks_to_generate, std::mutex& chunks_to_generate_mutex,
-                      std::vector<Chunk*> &chunks_to_create, std::mutex &chunks_to_create_mutex,
-                      std::vector<Chunk*>& chunks_to_save, std::mutex& chunks_to_save_mutex,
-                      std::vector<ChunkVBOData>& created_chunks, std::mutex& created_chunks_mutex,
-                      std::unordered_set<int64_t>& saved_chunks, std::mutex& saved_chunks_mutex,
-                      QString& savename, std::atomic_bool& idle, std::atomic_bool& terminate)
+void Terrain::doJob(const ChunkJob &job)
 {
-    // Continuously loop, looking for new inputs
-    while (true)
+    Chunk* c = job.chunk;
+    // Only saves still need to happen once their chunk is unloaded
+    bool stale = job.epoch != c->getEpoch();
+    switch (job.type)
     {
-        int workDone = 0;
-        workDone += generate_chunks(chunks_to_generate, chunks_to_generate_mutex,
-                        chunks_to_create, chunks_to_create_mutex,
-                        saved_chunks, saved_chunks_mutex, savename);
-        workDone += create_chunks(chunks_to_create, chunks_to_create_mutex,
-                      created_chunks, created_chunks_mutex);
-        workDone += save_chunks(chunks_to_save,chunks_to_save_mutex, savename);
-
-        idle.store(!workDone);
-        if (terminate.load() && !workDone) break;
-    }
-}
-
-int generate_chunks(std::vector<Chunk*>& chunks_to_generate, std::mutex& chunks_to_generate_mutex,
-                     std::vector<Chunk*>& chunks_to_create, std::mutex& chunks_to_create_mutex,
-                     std::unordered_set<int64_t>& saved_chunks, std::mutex& saved_chunks_mutex, QString& savename)
-{
-    int workDone = 0;
-    // Generate blocktype data for each chunk in the given input vector
-    chunks_to_generate_mutex.lock();
-    for (Chunk* c : chunks_to_generate)
+    case GENERATE_JOB:
     {
-        saved_chunks_mutex.lock();
-        bool hasFile = !(saved_chunks.find(c->getKey()) == saved_chunks.end());
-        saved_chunks_mutex.unlock();
+        if (stale)
+        {
+            // Generated if its zone comes back in range
+            c->setState(ALLOCATED);
+            cancelled_generations++;
+            generation_events.push(std::move(c));
+            break;
+        }
+        savedMutex.lock();
+        bool hasFile = saved.find(c->getKey()) != saved.end();
+        savedMutex.unlock();
 
         if (hasFile) {
-            c->load(savename);
-        } else {
-            c->setChunkGenHeights();
+            c->load(savename, terrain_gen);
+            generation_events.push(std::move(c));
+            break;
         }
-
-        if (c->canCreate()){
-            chunks_to_create_mutex.lock();
-            chunks_to_create.push_back(c);
-            chunks_to_create_mutex.unlock();
+        sPtr<const ZoneFields> fields = zone_fields.get(terrain_gen, toCoords(zoneKeyOf(c->getMinPos())));
+        // With no more jobs than workers, some workers would sit idle, so the
+        // Chunk's column parallel stages are split among them. Otherwise every
+        // worker already has a Chunk of its own to generate.
+        int strips = jobs.pendingJobs() <= NUM_CORES ? GENERATION_STRIPS : 1;
+        runGeneration(c, mkS<GenerationTask>(c->getMinPos(), terrain_gen, fields, strips), -1);
+        break;
+    }
+    case GENERATE_STRIP_JOB:
+        // Run even once stale, since the Chunk's generation waits on every strip
+        runGeneration(c, job.generation, job.section);
+        break;
+    case MESH_JOB:
+    case SECTION_MESH_JOB:
+    {
+        if (stale)
+        {
+            cancelled_meshes++;
+            break;
+        }
+        ChunkVBOData c_data = ChunkVBOData(c, job.epoch);
+        if (job.type == MESH_JOB)
+        {
+            c->makeDrawableVBOs(c_data);
+        }
+        else
+        {
+            c->makeSectionVBOs(c_data, job.section);
+        }
+        // The chunk was unloaded while we were meshing it
+        if (job.epoch != c->getEpoch())
+        {
+            Chunk::releaseVBOData(c_data);
+            cancelled_meshes++;
+            break;
+        }
+        if (job.type == MESH_JOB)
+        {
+            c->tryTransition(MESHING, MESHED);
         }
 
-        workDone++;
+        created_chunks.push(std::move(c_data));
+        break;
+    }
+    case SAVE_JOB:
+        c->save(savename);
+        break;
+    case COMPRESS_JOB:
+    {
+        ColdChunkData cold{c, 0, ColdBlocks()};
+        cold.blocks = c->compressBlocks(cold.version);
+        compressed_chunks.push(std::move(cold));
+        break;
+    }
     }
-    chunks_to_generate.clear();
-    chunks_to_generate_mutex.unlock();
-    return workDone;
 }
 
-
-int create_chunks(std::vector<Chunk*>& chunks_to_create, std::mutex& chunks_to_create_mutex,
-                   std::vector<ChunkVBOData>& created_chunks, std::mutex& created_chunks_mutex)
+void Terrain::runGeneration(Chunk* c, const sPtr<GenerationTask> &task, int strip)
 {
-    int workDone = 0;
-    // Generate VBO data for each chunk in the given input vector
-    chunks_to_create_mutex.lock();
-    for (Chunk* c : chunks_to_create)
-    {
-        std::vector<glm::vec4> vboOpaque, vboTransparent;
-        std::vector<GLuint> idxOpaque, idxTransparent;
-        c->makeDrawableVBOs(vboOpaque, idxOpaque, vboTransparent, idxTransparent);
-        ChunkVBOData c_data = ChunkVBOData(c);
-        c_data.idxDataOpaque = idxOpaque;
-        c_data.idxDataTransparent = idxTransparent;
-        c_data.vboDataOpaque = vboOpaque;
-        c_data.vboDataTransparent = vboTransparent;
-
-        created_chunks_mutex.lock();
-        created_chunks.push_back(c_data);
-        created_chunks_mutex.unlock();
-        workDone++;
-    }
-    chunks_to_create.clear();
-    chunks_to_create_mutex.unlock();
-    return workDone;
-}
-
-int save_chunks(std::vector<Chunk*>& chunks_to_save, std::mutex& chunks_to_save_mutex, QString& savename) {
-    int workDone = 0;
-    chunks_to_save_mutex.lock();
-    for (Chunk* c : chunks_to_save) {
-        c->save(savename);
-        workDone++;
+    auto spawnStrip = [this, c, &task](int i) {
+        ChunkJob job{GENERATE_STRIP_JOB, c};
+        job.section = i;
+        job.generation = task;
+        jobs.push(job);
+    };
+    bool finished = strip == -1 ? generation_pipeline.start(*task, spawnStrip)
+                                : generation_pipeline.runStrip(*task, strip, spawnStrip);
+    if (finished)
+    {
+        c->commitGeneration(task->context);
+        generation_events.push(std::move(c));
     }
-    chunks_to_save.clear();
-    chunks_to_save_mutex.unlock();
-    return workDone;
 }
 
 void Terrain::load(QString savename) {
@@ -614,27 +1161,54 @@ void Terrain::load(QString savename) {
     // load prevous player posiition and seed
     in >> prev_pos.x >> prev_pos.y >> prev_pos.z;
     in >> seed;
-    TerrainGen::setSeed(seed);
 
     while (!in.atEnd()) {
         int64_t chunkKey;
         in >> chunkKey;
+        if (chunkKey == SAVE_NOISE_HASH_TAG) {
+            // Already read by readGenerator
+            int hash;
+            in >> hash;
+            continue;
+        }
         saved.insert(chunkKey);
     }
 
     file.close();
+}
+
+TerrainGen Terrain::readGenerator(QString savename) {
+    QFile file("../saves/"+savename+"/"+savename+".save");
+    file.open(QIODevice::ReadOnly);
+    QDataStream in(&file);
+
+    glm::vec3 pos;
+    int seed;
+    in >> pos.x >> pos.y >> pos.z;
+    in >> seed;
+    // Worlds saved before the hash was recorded use TRIG_HASH
+    NoiseHash noise_hash = TRIG_HASH;
+    while (!in.atEnd()) {
+        int64_t chunkKey;
+        in >> chunkKey;
+        if (chunkKey == SAVE_NOISE_HASH_TAG) {
+            int hash;
+            in >> hash;
+            noise_hash = static_cast<NoiseHash>(hash);
+            break;
+        }
+    }
 
-    threadsAreNotIdle();
+    file.close();
+    return TerrainGen(seed, noise_hash);
 }
 
 void Terrain::save() {
-    int i = 0;
     for (Chunk* chunk : updated) {
+        savedMutex.lock();
         saved.insert(chunk->getKey());
-        chunks_needing_saving_mutexes[i].lock();
-        chunks_needing_saving[i].push_back(chunk);
-        chunks_needing_saving_mutexes[i].unlock();
-        i = (i + 1) % NUM_CORES;
+        savedMutex.unlock();
+        jobs.push({SAVE_JOB, chunk});
     }
 
     QFile file("../saves/"+savename+"/"+savename+".save");
@@ -643,26 +1217,55 @@ void Terrain::save() {
 
     out << prev_pos.x << prev_pos.y << prev_pos.z;
     out << seed;
+    out << int64_t(SAVE_NOISE_HASH_TAG) << int(terrain_gen.getHash());
 
     for(int64_t chunk : saved) {
         out << chunk;
     }
 
     file.close();
+}
 
-    threadsAreNotIdle();
+bool Terrain::threadsIdle() {
+    return jobs.pendingJobs() == 0;
 }
 
-void Terrain::threadsAreNotIdle() {
-    for (int i = 0; i < NUM_CORES; i++) {
-        idle_threads[i].store(false);
-    }
+int Terrain::getMeshAllocations() const {
+    return mesh_allocations;
 }
 
-bool Terrain::threadsIdle() {
-    bool idle = true;
-    for (int i = 0; i < NUM_CORES; i++) {
-        idle = idle && idle_threads[i].load();
-    }
-    return idle;
+void Terrain::setBlockMemoryBudget(size_t bytes) {
+    block_memory_budget = bytes;
+}
+
+size_t Terrain::getBlockMemoryBudget() const {
+    return block_memory_budget;
+}
+
+size_t Terrain::getBlockBytes() const {
+    return block_bytes;
+}
+
+int Terrain::getUnloadedZones() const {
+    return unloaded_zones;
+}
+
+const TerrainGen &Terrain::getTerrainGen() const {
+    return terrain_gen;
+}
+
+const ZoneFieldCache &Terrain::getZoneFieldCache() const {
+    return zone_fields;
+}
+
+const GenerationPipeline &Terrain::getGenerationPipeline() const {
+    return generation_pipeline;
+}
+
+ChunkStorageStats Terrain::getStorageStats() const {
+    return storage_stats;
+}
+
+glm::ivec3 Terrain::getCancelledWork() const {
+    return glm::ivec3(cancelled_generations.load(), cancelled_meshes.load(), discarded_vbo_data.load());
 }
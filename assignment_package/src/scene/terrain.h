@@ -2,6 +2,9 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include "chunk.h"
+#include "chunkgrid.h"
+#include "zonefieldcache.h"
+#include "generationpipeline.h"
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
@@ -12,6 +15,8 @@
 #include <atomic>
 
 #include <scene/terraingen.h>
+#include "jobsystem.h"
+#include "mpscqueue.h"
 
 #include "tree.h"
 
@@ -23,8 +28,39 @@
 #define CREATE_RADIUS 2
 #define DRAW_RADIUS 1
 
+// Default per-frame limits on how much chunk VBO data Terrain sends to the GPU
+#define UPLOAD_BUDGET_MS 2.f
+#define UPLOAD_BUDGET_BYTES (4 << 20)
+
+// Cold Chunks that came back within CREATE_RADIUS are thawed a few per frame,
+// since each one takes about a quarter of a millisecond
+#define THAW_CHUNKS_PER_FRAME 4
+
+// Default limit on the memory held by the blocks of loaded Chunks, past which
+// the least recently visited zones outside CREATE_RADIUS are unloaded
+#define BLOCK_MEMORY_BUDGET (size_t(256) << 20)
+
 //using namespace std;
 
+// Blocks a worker compressed for the cold tier, waiting for the main thread to swap them in
+struct ColdChunkData
+{
+    Chunk* chunk;
+    // The Chunk's block version when it was compressed
+    unsigned int version;
+    ColdBlocks blocks;
+};
+
+// How the blocks of the loaded Chunks are stored, as of the last tryExpansion
+struct ChunkStorageStats
+{
+    int hotChunks, coldChunks;
+    size_t hotBytes, coldBytes;
+    // The size of the blocks of every Chunk moved to the cold tier so far,
+    // before and after compression
+    size_t compressedFrom, compressedTo;
+};
+
 // Helper functions to convert (x, z) to and from hash map key
 int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
@@ -41,6 +77,10 @@ private:
     // so that we can use them as a key for the map, as objects like std::pairs or
     // glm::ivec2s are not hashable by default, so they cannot be used as keys.
     std::unordered_map<int64_t, uPtr<Chunk>> m_chunks;
+    // The Chunks around the player, so that getBlockAt and hasChunkAt don't
+    // go through m_chunks. Kept in sync with it by instantiateChunkAt and
+    // unloadZone, and recentred on the player by tick.
+    ChunkGrid chunk_grid;
 
     // We will designate every 64 x 64 area of the world's x-z plane
     // as one "terrain generation zone". Every time the player moves
@@ -53,24 +93,50 @@ private:
     // When milestone 1 has been implemented, the Player can move around the
     // world to add more "terrain generation zone" IDs to this set.
     // While only the 3 x 3 collection of terrain generation zones
-    // surrounding the Player should be rendered, the Chunks
-    // in the Terrain will never be deleted until the program is terminated.
+    // surrounding the Player should be rendered, the Chunks of the zones
+    // outside CREATE_RADIUS stay loaded until their blocks take up more than
+    // the block memory budget. Then whole zones are unloaded, least recently
+    // visited first, and their keys removed from this set, so that they are
+    // generated (or loaded from the save) again if the player comes back.
     std::unordered_set<int64_t> m_generatedTerrain;
+    // The tryExpansion call during which each zone was last within CREATE_RADIUS
+    std::unordered_map<int64_t, unsigned int> zone_last_used;
+    unsigned int expansion_count;
+
+    // The zones within CREATE_RADIUS as of the last tryExpansion. Chunks of the
+    // other zones are compressed into the cold tier and thawed when they return.
+    std::unordered_set<int64_t> active_zones;
+
+    size_t block_memory_budget;
+    // Memory held by the blocks of every loaded Chunk, as of the last tryExpansion
+    size_t block_bytes;
+    int unloaded_zones;
+    ChunkStorageStats storage_stats;
+
+    // Cold tier blocks made by the worker threads, waiting to be swapped in
+    MPSCQueue<ColdChunkData> compressed_chunks;
+    // Cold Chunks within CREATE_RADIUS, waiting to be thawed. They can
+    // already be meshed, since snapshots read cold Chunks' blocks too.
+    std::vector<Chunk*> thaw_queue;
+
+    // Chunks whose generation a worker finished or cancelled
+    MPSCQueue<Chunk*> generation_events;
+    // Taken from generation_events, waiting for handleGenerationEvents.
+    // Only touched by the main thread.
+    std::vector<Chunk*> pending_generation_events;
 
     OpenGLContext* mp_context;
 
-    // Set which will contain the terrain and chunk data generated/created by the BlockTypeWorkers/VBOWorkers
-    std::array<std::vector<Chunk*>, NUM_CORES> chunks_needing_generated;
-    std::array<std::mutex, NUM_CORES> chunks_needing_generated_mutexes;
-
-    std::array<std::vector<Chunk*>, NUM_CORES> chunks_needing_created;
-    std::array<std::mutex, NUM_CORES> chunks_needing_created_mutexes;
-
-    std::vector<ChunkVBOData> created_chunks;
-    std::mutex created_chunks_mutex;
+    // VBO data made by the worker threads, waiting to be sent to the GPU
+    MPSCQueue<ChunkVBOData> created_chunks;
 
-    // Vector of threads representing both our BlockType Workers and VBOWorkers
-    std::vector<std::thread> threads;
+    // VBO data taken from created_chunks that did not fit in an earlier frame's
+    // upload budget. Only touched by the main thread.
+    std::vector<ChunkVBOData> upload_backlog;
+    float upload_budget_ms;
+    size_t upload_budget_bytes;
+    // Mesh buffer allocations made during the last frame
+    int mesh_allocations;
 
     // Timer for generating terrain; since the player is not going to enter a new
     // zone every tick, we can make things more efficient by firing
@@ -80,33 +146,108 @@ private:
     // vec3 containing position of the player when we last tried to load new terrain
     glm::vec3 prev_pos;
 
+    // Where the player was and which way they looked when the jobs were last prioritized
+    glm::vec3 focus_pos, focus_forward;
+
     std::vector<uPtr<Tree>> trees;
 
     // for loading
     std::unordered_set<int64_t> saved;
     std::mutex savedMutex;
     std::unordered_set<Chunk*> updated;
+    // Bit i is set for each section i of a Chunk that was edited this frame
+    // and still has to be sent to the threads to be re-meshed
+    std::unordered_map<Chunk*, uint16_t> dirty_sections;
     QString savename;
-    std::array<std::vector<Chunk*>, NUM_CORES> chunks_needing_saving;
-    std::array<std::mutex, NUM_CORES> chunks_needing_saving_mutexes;
 
     int seed;
-
-    std::array<std::atomic_bool,NUM_CORES> idle_threads;
-    std::atomic_bool terminate;
+    // Generates this world's Chunks on the worker threads. Fixed when the
+    // Terrain is made, since jobs in flight keep a reference to it.
+    const TerrainGen terrain_gen;
+    // Low-frequency terrain terms of the zones being generated, shared by their Chunks
+    ZoneFieldCache zone_fields;
+    // The stages every generated Chunk goes through, with their timings
+    GenerationPipeline generation_pipeline;
+
+    // How much work was thrown away because its Chunk was unloaded first
+    std::atomic_int cancelled_generations, cancelled_meshes, discarded_vbo_data;
+
+    // The NUM_CORES worker threads that generate, mesh and save Chunks.
+    // Declared last so that it is destroyed (finishing its jobs) before
+    // anything the jobs touch.
+    JobSystem jobs;
+
+    // Carries out one job on a worker thread
+    void doJob(const ChunkJob &job);
+    // Runs one strip of c's generation, or starts it when strip is -1, and hands
+    // c to the main thread if that finished it. Strips of the task's later
+    // COLUMN_PARALLEL stages are pushed as GENERATE_STRIP_JOBs.
+    void runGeneration(Chunk* c, const sPtr<GenerationTask> &task, int strip);
+
+    // Moves the VBO data the workers have finished into upload_backlog,
+    // keeping only the newest mesh of each Chunk or section
+    void collectFinishedMeshes();
+
+    // Swaps in the blocks the workers compressed, unless their Chunk
+    // came back within CREATE_RADIUS or was edited in the meantime
+    void freezeCompressedChunks();
+    // Thaws up to THAW_CHUNKS_PER_FRAME Chunks of thaw_queue
+    void thawChunks();
+    // Queues the compression of the Chunks outside CREATE_RADIUS
+    // that are still hot, then measures both tiers
+    void updateStorageTiers();
+
+    // Unloads zones outside active, least recently visited first, until the
+    // blocks of the loaded Chunks fit in the block memory budget
+    void unloadZones(const std::unordered_set<int64_t> &active);
+    // Whether the zone's Chunks can be deleted now. Edited Chunks are sent to
+    // be saved first, and no job may still be using the Chunks or their neighbors.
+    bool prepareZoneUnload(int64_t key);
+    // Deletes the zone's Chunks and forgets it was generated; returns the block memory freed
+    size_t unloadZone(int64_t key);
+
+    // Whether the Chunk's zone is within CREATE_RADIUS
+    bool isActive(const Chunk* c) const;
+    // Queues a full mesh of c if it is within CREATE_RADIUS, generated,
+    // not meshed yet, and its four neighbors are generated
+    void queueMesh(Chunk* c);
+    // Queues the mesh of every Chunk that a finished generation left with
+    // all of its neighbors generated, and generates again the Chunks within
+    // CREATE_RADIUS whose generation was cancelled
+    void handleGenerationEvents();
+
+    // Marks a section of c as edited, to be re-meshed on the next tick
+    // Reads the player position and saved Chunks from the world's .save
+    void load(QString savename);
+    void markSectionDirty(Chunk* c, int section);
+    // Pushes a SECTION_MESH_JOB for every section edited since the last tick
+    void remeshDirtySections();
 
 public:
-    Terrain(OpenGLContext *context);
-    Terrain(OpenGLContext *context, QString savename);
+    // A world that is never saved, generated by gen
+    Terrain(OpenGLContext *context, const TerrainGen &gen = TerrainGen());
+    // The saved world savename, generated by gen, which readGenerator
+    // makes from the world's .save
+    Terrain(OpenGLContext *context, QString savename, const TerrainGen &gen);
     ~Terrain();
 
+    // The generator of the saved world savename, from the seed and noise hash
+    // in its .save header
+    static TerrainGen readGenerator(QString savename);
+
     // Instantiates a new Chunk and stores it in
     // our chunk map at the given coordinates.
     // Returns a pointer to the created Chunk.
     Chunk* instantiateChunkAt(int x, int z);
-    // Do these world-space coordinates lie within
-    // a Chunk that exists?
+    // Do these world-space coordinates lie within a Chunk whose blocks
+    // are generated? Only then may getBlockAt and setBlockAt be called.
     bool hasChunkAt(int x, int z) const;
+    // The Chunk containing world-space (x, z), or null if there is none.
+    // Uses chunk_grid near the player and m_chunks everywhere else.
+    Chunk* findChunk(int x, int z) const;
+    // As findChunk, but also null while the Chunk's blocks are being generated
+    // or loaded by a worker, when the main thread must not touch them
+    Chunk* findGeneratedChunk(int x, int z) const;
     // Assuming a Chunk exists at these coords,
     // return a mutable reference to it
     uPtr<Chunk>& getChunkAt(int x, int z);
@@ -115,11 +256,24 @@ public:
     const uPtr<Chunk>& getChunkAt(int x, int z) const;
     // Given a world-space coordinate (which may have negative
     // values) return the block stored at that point in space.
+    // Like TerrainView, it reads without any lock, so only the main thread
+    // may call it: workers write a Chunk's blocks until it is generated, and
+    // hasChunkAt is false until then. Worker threads read blocks through a
+    // BlockSnapshot, or hold the Chunk's blockMutex.
     BlockType getBlockAt(int x, int y, int z) const;
     BlockType getBlockAt(glm::vec3 p) const;
+    // The y of the top block of the given kind in the world-space column
+    // at (x, z), or -1 if the column has none or its Chunk is not generated yet.
+    // Reads the Chunk's heightmap, so it costs the same as getBlockAt.
+    int getHeightAt(HeightmapType type, int x, int z) const;
+    // Copies the column heights of the whole 64 x 64 terrain generation zone
+    // containing (x, z) into out, indexed (x - zoneX) + 64 * (z - zoneZ).
+    // Returns false, leaving out unchanged, unless all 16 of its Chunks are generated.
+    bool getZoneHeightmap(HeightmapType type, int x, int z, std::array<int16_t, 4096> &out) const;
     // Given a world-space coordinate (which may have negative
     // values) set the block at that point in space to the
     // given type.
+    // The affected sections are re-meshed by the threads on the next tick.
     void setBlockAt(int x, int y, int z, BlockType t);
 
     // Draws every Chunk that falls within the bounding box
@@ -130,8 +284,35 @@ public:
     // Creates new chunks when the player is within 16 blocks of an edge of a chunk that does not connect to an existing chunk
     void expandTerrain(const glm::vec3 &player_pos);
 
-    // Function called every tick, checking for terrain updates based on player_pos
-    void tick(const glm::vec3 &player_pos, float dt);
+    // Function called every tick, checking for terrain updates based on player_pos.
+    // player_forward is where the player's camera looks, so chunks in view get loaded first
+    void tick(const glm::vec3 &player_pos, const glm::vec3 &player_forward, float dt);
+
+    // Uploads finished chunk meshes, nearest to the player first,
+    // until this frame's time or byte budget is used up
+    void uploadChunks(const glm::vec3 &player_pos);
+    void setUploadBudget(float ms, size_t bytes);
+    // Number of meshed chunks still waiting to be uploaded
+    size_t getUploadBacklog() const;
+    // Number of heap allocations the mesh buffers needed during the last frame
+    int getMeshAllocations() const;
+
+    // Block bytes kept loaded before the farthest zones are unloaded, BLOCK_MEMORY_BUDGET
+    // unless MINIMINECRAFT_BLOCK_BUDGET_MB gives the game another number of MB
+    void setBlockMemoryBudget(size_t bytes);
+    size_t getBlockMemoryBudget() const;
+    // Memory held by the blocks of every loaded Chunk
+    size_t getBlockBytes() const;
+    // Number of zones unloaded to stay within the block memory budget
+    int getUnloadedZones() const;
+    // Hot and cold Chunk counts and sizes, and the cold tier's compression
+    ChunkStorageStats getStorageStats() const;
+    // The generator of this world's Chunks
+    const TerrainGen &getTerrainGen() const;
+    // Hits and misses of the zone field cache so far
+    const ZoneFieldCache &getZoneFieldCache() const;
+    // The generation stages and the time spent in each so far
+    const GenerationPipeline &getGenerationPipeline() const;
 
     // Function for creating BlockType Workers for terrain expansion (and deloading of chunks)
     void tryExpansion(const glm::vec3 &player_pos, const glm::vec3 &prev_pos);
@@ -142,6 +323,10 @@ public:
     // Helper function for unloading chunks
     void deleteTerrain(int64_t &key);
 
+    // Switches every Chunk to the given mesher and sends the Chunks
+    // that are currently drawn back to the threads to be re-meshed
+    void setMeshingMode(MeshingMode mode);
+
     void createTree(glm::ivec4& pos);
 
     void growTrees(qint64 currTime);
@@ -149,31 +334,11 @@ public:
     void buildTree(glm::ivec4& pos, std::vector<TreeSymbol>& axiom);
   
     void save();
-    void load(QString savename);
 
+    // True when no generate, mesh or save jobs are queued or running
     bool threadsIdle();
-    void threadsAreNotIdle();
-};
 
-// Function for our BlockTypeWorker's to continuously run
-// waiting for ivec2's representing chunks to be generated at
-// the given two x and z coordinates
-int generate_chunks(std::vector<Chunk*>& chunks_to_generate, std::mutex& chunks_to_generate_mutex,
-                     std::vector<Chunk*>& chunks_to_create, std::mutex& chunks_to_create_mutex,
-                     std::unordered_set<int64_t>& saved_chunks, std::mutex& saved_chunks_mutex, QString& savename);
-
-// Function for our VBOWorkers to continuously run
-// waiting for Chunk*'s to create the VBO data
-int create_chunks(std::vector<Chunk*> &chunks_to_create, std::mutex& chunks_to_create_mutex,
-                   std::vector<ChunkVBOData>& created_chunks, std::mutex& created_chunks_mutex);
-
-int save_chunks(std::vector<Chunk*>& chunks_to_save, std::mutex& chunks_to_save_mutex, QString& savename);
-
-// Function for our threads to continuously run
-// Does both the work for blocktype data and VBO data in one function
-void multithread_work(std::vector<Chunk*>& chunks_to_generate, std::mutex& chunks_to_generate_mutex,
-                      std::vector<Chunk*> &chunks_to_create, std::mutex &chunks_to_create_mutex,
-                      std::vector<Chunk*>& chunks_to_save, std::mutex& chunks_to_save_mutex,
-                      std::vector<ChunkVBOData>& created_chunks, std::mutex& created_chunks_mutex,
-                      std::unordered_set<int64_t>& saved_chunks, std::mutex& saved_chunks_mutex,
-                      QString& savename, std::atomic_bool& idle, std::atomic_bool& terminate);
+    // Number of generate jobs, mesh jobs and finished meshes that were
+    // dropped because their Chunk left CREATE_RADIUS first
+    glm::ivec3 getCancelledWork() const;
+};
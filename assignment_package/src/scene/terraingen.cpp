@@ -1,21 +1,56 @@
 #include "terraingen.h"
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// getHeights evaluates four columns at a time with SSE2, which every x86-64
+// CPU has, and one at a time on other CPUs
+#if defined(__SSE2__)
+#define HEIGHTS_SSE2
+#include <emmintrin.h>
+#endif
+
+TerrainGen::TerrainGen(float seed, NoiseHash hash, int caveSpacing)
+    : seed(seed), hash(hash), caveSpacing(caveSpacing) {
+    // The cave lattice has to line up with the Chunk's edges
+    if (caveSpacing < 1 || 16 % caveSpacing != 0) {
+        throw std::invalid_argument("cave spacing " + std::to_string(caveSpacing) + " must be at least 1 and divide 16");
+    }
+}
+
+// PCG hash of one 32-bit word (Jarzynski and Olano, "Hash Functions for GPU Rendering")
+static uint32_t pcgHash(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
 
-TerrainGen::TerrainGen() {}
+// The top 24 bits of h as a float in [0, 1), which holds them exactly
+static float unitFloat(uint32_t h) {
+    return (h >> 8) * (1.f / 16777216.f);
+}
 
-float TerrainGen::seed = 0;
+// Lattice points have whole coordinates, so they convert to int exactly
+static uint32_t latticeWord(float f) {
+    return static_cast<uint32_t>(static_cast<int32_t>(f));
+}
 
-glm::vec2 TerrainGen::random2(glm::vec2 p) {
+glm::vec2 TerrainGen::random2(glm::vec2 p) const {
+    if (hash == INTEGER_HASH) {
+        uint32_t h = pcgHash(latticeWord(p.x) ^ pcgHash(latticeWord(p.y) ^ pcgHash(latticeWord(seed))));
+        return glm::vec2(unitFloat(h), unitFloat(pcgHash(h)));
+    }
     return glm::fract(glm::cos(
                           glm::vec2(glm::dot(p, glm::vec2(57.2, 23.2)), glm::dot(p, glm::vec2(152.4, 777777.44))) + glm::vec2(seed,seed))
                       * glm::vec2(998877.654321));
 }
 
-float TerrainGen::noise2D(glm::vec2 p) {
+float TerrainGen::noise2D(glm::vec2 p) const {
     return random2(p).x;
 }
 
-float TerrainGen::interpNoise2D(glm::vec2 xy) {
+float TerrainGen::interpNoise2D(glm::vec2 xy) const {
     int intX = int(floor(xy.x));
     float fractX = glm::fract(xy.x);
     int intY = int(floor(xy.y));
@@ -32,7 +67,7 @@ float TerrainGen::interpNoise2D(glm::vec2 xy) {
 }
 
 
-float TerrainGen::fbm(glm::vec2 xy) {
+float TerrainGen::fbm(glm::vec2 xy) const {
     float total = 0;
     float persistence = 0.7f;
     int octaves = 6;
@@ -48,7 +83,7 @@ float TerrainGen::fbm(glm::vec2 xy) {
     return total;
 }
 
-float TerrainGen::WorleyNoise(glm::vec2 uv) {
+float TerrainGen::WorleyNoise(glm::vec2 uv) const {
     uv *= 5.0; // Now the space is 10x10 instead of 1x1. Change this to any number you want.
     glm::vec2 uvInt = glm::floor(uv);
     glm::vec2 uvFract = glm::fract(uv);
@@ -71,7 +106,7 @@ float TerrainGen::WorleyNoise(glm::vec2 uv) {
     return minDist2 - minDist1;
 }
 
-std::pair<float, bool> TerrainGen::WorleyNoise2(glm::vec2 uv) {
+std::pair<float, bool> TerrainGen::WorleyNoise2(glm::vec2 uv) const {
     uv *= 10.0; // Now the space is 10x10 instead of 1x1. Change this to any number you want.
     glm::vec2 uvInt = glm::floor(uv);
     glm::vec2 uvFract = glm::fract(uv);
@@ -96,7 +131,7 @@ std::pair<float, bool> TerrainGen::WorleyNoise2(glm::vec2 uv) {
     return {minDist, false};
 }
 
-float TerrainGen::WorleyNoise3(float x, float y) {
+float TerrainGen::WorleyNoise3(float x, float y) const {
     glm::vec2 uv = glm::vec2(x, y);
     uv *= 10.0; // Now the space is 10x10 instead of 1x1. Change this to any number you want.
     glm::vec2 uvInt = glm::floor(uv);
@@ -116,7 +151,7 @@ float TerrainGen::WorleyNoise3(float x, float y) {
     return minDist;
 }
 
-float TerrainGen::surflet(glm::vec2 P, glm::vec2 gridPoint) {
+float TerrainGen::surflet(glm::vec2 P, glm::vec2 gridPoint) const {
     // Compute falloff function by converting linear distance to a polynomial
     float distX = abs(P.x - gridPoint.x);
     float distY = abs(P.y - gridPoint.y);
@@ -133,7 +168,7 @@ float TerrainGen::surflet(glm::vec2 P, glm::vec2 gridPoint) {
 }
 
 
-float TerrainGen::PerlinNoise(glm::vec2 uv) {
+float TerrainGen::PerlinNoise(glm::vec2 uv) const {
     uv *= 10.0;
     float surfletSum = 0.f;
     // Iterate over the four integer corners surrounding uv
@@ -145,7 +180,13 @@ float TerrainGen::PerlinNoise(glm::vec2 uv) {
     return surfletSum;
 }
 
-glm::vec3 TerrainGen::random3(glm::vec3 xyz) {
+glm::vec3 TerrainGen::random3(glm::vec3 xyz) const {
+    if (hash == INTEGER_HASH) {
+        uint32_t h = pcgHash(latticeWord(xyz.x) ^ pcgHash(latticeWord(xyz.y)
+                             ^ pcgHash(latticeWord(xyz.z) ^ pcgHash(latticeWord(seed)))));
+        uint32_t h2 = pcgHash(h);
+        return glm::vec3(unitFloat(h), unitFloat(h2), unitFloat(pcgHash(h2)));
+    }
     return glm::fract(glm::sin(
                           glm::vec3(
                               glm::dot(xyz, glm::vec3(12, 21412.2, 124.23)),
@@ -153,7 +194,7 @@ glm::vec3 TerrainGen::random3(glm::vec3 xyz) {
                               glm::dot(xyz, glm::vec3(214.5, 83.2, 555))) + glm::vec3(seed,seed,seed)) * glm::vec3(43758.5453));
 }
 
-float TerrainGen::surflet3D(glm::vec3 p, glm::vec3 gridPoint) {
+float TerrainGen::surflet3D(glm::vec3 p, glm::vec3 gridPoint) const {
     // Compute the distance between p and the grid point along each axis, and warp it with a
     // quintic function so we can smooth our cells
     glm::vec3 t2 = glm::abs(p - gridPoint);
@@ -172,7 +213,7 @@ float TerrainGen::surflet3D(glm::vec3 p, glm::vec3 gridPoint) {
     return height * t.x * t.y * t.z;
 }
 
-float TerrainGen::perlinNoise3D(glm::vec3 p) {
+float TerrainGen::perlinNoise3D(glm::vec3 p) const {
     float surfletSum = 0.f;
     // Iterate over the four integer corners surrounding uv
     for(int dx = 0; dx <= 1; ++dx) {
@@ -186,7 +227,7 @@ float TerrainGen::perlinNoise3D(glm::vec3 p) {
 }
 
 
-float TerrainGen::getMountainH(glm::vec2 xz) {
+float TerrainGen::getMountainH(glm::vec2 xz) const {
 
     float mountainsH = 0.f;
 
@@ -206,7 +247,7 @@ float TerrainGen::getMountainH(glm::vec2 xz) {
     return mountainsH;
 }
 
-float TerrainGen::getGrasslandsH(glm::vec2 xz) {
+float TerrainGen::getGrasslandsH(glm::vec2 xz) const {
 
     float grasslandsH = 0.f;
 
@@ -226,7 +267,7 @@ float TerrainGen::getGrasslandsH(glm::vec2 xz) {
     return grasslandsH;
 }
 
-std::pair<float, bool> TerrainGen::getVolcanoH(glm::vec2 xz) {
+std::pair<float, bool> TerrainGen::getVolcanoH(glm::vec2 xz) const {
     float volcanoH = 0.f;
     float freq = 2600.f;
     std::pair<float, bool> worleyRes = WorleyNoise2(xz / freq);
@@ -238,27 +279,320 @@ std::pair<float, bool> TerrainGen::getVolcanoH(glm::vec2 xz) {
     return {volcanoH, worleyRes.second};
 }
 
-float TerrainGen::BiomeBlender(glm::vec2 xz) {
+float TerrainGen::BiomeBlender(glm::vec2 xz) const {
     return 0.5 * (5 * (PerlinNoise(xz / 4000.f)) + 1.f);
 }
 
-std::tuple<int, BiomeType, bool> TerrainGen::getHeight(glm::vec2 xz) {
-    float g = getGrasslandsH(xz), m = getMountainH(xz);
-    std::pair<float, bool> v = getVolcanoH(xz);
-    float blend = glm::smoothstep(0.35f, 0.5f, BiomeBlender(xz));
-    float height = glm::mix(g, m, blend);
+ColumnHeight TerrainGen::blendHeights(float grasslandsH, float mountainsH,
+                                      std::pair<float, bool> volcano, float biomeBlend) {
+    float blend = glm::smoothstep(0.35f, 0.5f, biomeBlend);
+    float height = glm::mix(grasslandsH, mountainsH, blend);
     height = glm::min(height,255.f);
 
     BiomeType b = blend < 0.6f ? GRASSLANDS : MOUNTAINS;
 
-    float blend2 = glm::smoothstep(170.f, 200.f, v.first);
-    height = glm::mix(height, v.first, blend2);
+    float blend2 = glm::smoothstep(170.f, 200.f, volcano.first);
+    height = glm::mix(height, volcano.first, blend2);
     if (blend2 > 0.6) {
         b = VOLCANO;
     }
-    return std::tuple<int, BiomeType, bool>(floor(height), b, v.second);
+    return ColumnHeight{int(floor(height)), b, volcano.second};
+}
+
+std::tuple<int, BiomeType, bool> TerrainGen::getHeight(glm::vec2 xz) const {
+    ColumnHeight c = blendHeights(getGrasslandsH(xz), getMountainH(xz), getVolcanoH(xz), BiomeBlender(xz));
+    return std::tuple<int, BiomeType, bool>(c.height, c.biome, c.vFlip);
+}
+
+struct NoiseLattice {
+    glm::ivec2 min;
+    int width;
+    // random2 of lattice point (min.x + i % width, min.y + i / width),
+    // or the Perlin gradient 2 * random2 - 1 made from it
+    std::vector<float> x, y;
+};
+
+NoiseLattice TerrainGen::lattice(glm::vec2 uvMin, glm::vec2 uvMax, bool gradient) const {
+    // One point of margin on each side covers the Worley neighbours and the upper Perlin corners
+    glm::ivec2 lo = glm::ivec2(glm::floor(uvMin)) - glm::ivec2(1);
+    glm::ivec2 hi = glm::ivec2(glm::floor(uvMax)) + glm::ivec2(1);
+    NoiseLattice l;
+    l.min = lo;
+    l.width = hi.x - lo.x + 1;
+    for (int y = lo.y; y <= hi.y; y++) {
+        for (int x = lo.x; x <= hi.x; x++) {
+            glm::vec2 r = random2(glm::vec2(x, y));
+            if (gradient) {
+                r = 2.f * r - glm::vec2(1.f);
+            }
+            l.x.push_back(r.x);
+            l.y.push_back(r.y);
+        }
+    }
+    return l;
+}
+
+namespace {
+
+// A row of adjacent columns, one per SIMD lane. lanesLess gives a mask
+// that lanesSelect uses to pick a's lanes where it is set and b's elsewhere.
+#if defined(HEIGHTS_SSE2)
+struct Lanes {
+    static const int WIDTH = 4;
+    __m128 v;
+    Lanes(float f) : v(_mm_set1_ps(f)) {}
+    Lanes(__m128 v) : v(v) {}
+};
+inline Lanes operator+(Lanes a, Lanes b) { return _mm_add_ps(a.v, b.v); }
+inline Lanes operator-(Lanes a, Lanes b) { return _mm_sub_ps(a.v, b.v); }
+inline Lanes operator*(Lanes a, Lanes b) { return _mm_mul_ps(a.v, b.v); }
+inline Lanes operator/(Lanes a, Lanes b) { return _mm_div_ps(a.v, b.v); }
+inline Lanes lanesIota() { return _mm_setr_ps(0, 1, 2, 3); }
+// SSE2 has no floor, so truncate and step down where that rounded up.
+// Only exact below 2^31, far beyond any noise coordinate.
+inline Lanes lanesFloor(Lanes a) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.f)));
+}
+inline Lanes lanesAbs(Lanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+inline Lanes lanesSqrt(Lanes a) { return _mm_sqrt_ps(a.v); }
+inline Lanes lanesLess(Lanes a, Lanes b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b) {
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+inline Lanes lanesGather(const float* table, Lanes index) {
+    alignas(16) int i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), _mm_cvttps_epi32(index.v));
+    return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+inline void lanesStore(float* out, Lanes a) { _mm_storeu_ps(out, a.v); }
+inline Lanes lanesLoad(const float* in) { return _mm_loadu_ps(in); }
+#else
+struct Lanes {
+    static const int WIDTH = 1;
+    float v;
+    Lanes(float f) : v(f) {}
+};
+inline Lanes operator+(Lanes a, Lanes b) { return a.v + b.v; }
+inline Lanes operator-(Lanes a, Lanes b) { return a.v - b.v; }
+inline Lanes operator*(Lanes a, Lanes b) { return a.v * b.v; }
+inline Lanes operator/(Lanes a, Lanes b) { return a.v / b.v; }
+inline Lanes lanesIota() { return 0.f; }
+inline Lanes lanesFloor(Lanes a) { return std::floor(a.v); }
+inline Lanes lanesAbs(Lanes a) { return std::abs(a.v); }
+inline Lanes lanesSqrt(Lanes a) { return std::sqrt(a.v); }
+inline Lanes lanesLess(Lanes a, Lanes b) { return a.v < b.v ? 1.f : 0.f; }
+inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b) { return mask.v != 0.f ? a : b; }
+inline Lanes lanesGather(const float* table, Lanes index) { return table[int(index.v)]; }
+inline void lanesStore(float* out, Lanes a) { *out = a.v; }
+inline Lanes lanesLoad(const float* in) { return *in; }
+#endif
+
+// Index into the lattice of the point at (u, v), which must lie inside it
+inline Lanes latticeIndex(const NoiseLattice &l, Lanes u, Lanes v) {
+    return (u - Lanes(float(l.min.x))) + Lanes(float(l.width)) * (v - Lanes(float(l.min.y)));
+}
+
+// As TerrainGen::PerlinNoise(xz / period), with 6t^5 - 15t^4 + 10t^3 computed by products
+Lanes perlinLanes(const NoiseLattice &l, Lanes colX, Lanes colZ, float period) {
+    Lanes u = colX / Lanes(period) * Lanes(10.f), v = colZ / Lanes(period) * Lanes(10.f);
+    Lanes cellU = lanesFloor(u), cellV = lanesFloor(v);
+    Lanes surfletSum(0.f);
+    for (int dx = 0; dx <= 1; ++dx) {
+        for (int dy = 0; dy <= 1; ++dy) {
+            Lanes gridU = cellU + Lanes(float(dx)), gridV = cellV + Lanes(float(dy));
+            Lanes distX = lanesAbs(u - gridU), distY = lanesAbs(v - gridV);
+            Lanes cubeX = distX * distX * distX, cubeY = distY * distY * distY;
+            Lanes tX = Lanes(1.f) - Lanes(6.f) * (cubeX * distX * distX) + Lanes(15.f) * (cubeX * distX) - Lanes(10.f) * cubeX;
+            Lanes tY = Lanes(1.f) - Lanes(6.f) * (cubeY * distY * distY) + Lanes(15.f) * (cubeY * distY) - Lanes(10.f) * cubeY;
+            Lanes i = latticeIndex(l, gridU, gridV);
+            Lanes height = (u - gridU) * lanesGather(l.x.data(), i) + (v - gridV) * lanesGather(l.y.data(), i);
+            surfletSum = surfletSum + height * tX * tY;
+        }
+    }
+    return surfletSum;
+}
+
+// As TerrainGen::WorleyNoise (scale 5) and WorleyNoise2 (scale 10) of xz / period,
+// giving the distances to the closest and second closest cell points
+void worleyLanes(const NoiseLattice &l, Lanes colX, Lanes colZ, float period, float scale,
+                 Lanes &minDist1, Lanes &minDist2) {
+    Lanes u = colX / Lanes(period) * Lanes(scale), v = colZ / Lanes(period) * Lanes(scale);
+    Lanes cellU = lanesFloor(u), cellV = lanesFloor(v);
+    Lanes fractU = u - cellU, fractV = v - cellV;
+    minDist1 = Lanes(1.f);
+    minDist2 = Lanes(1.f);
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            Lanes i = latticeIndex(l, cellU + Lanes(float(x)), cellV + Lanes(float(y)));
+            Lanes diffU = Lanes(float(x)) + lanesGather(l.x.data(), i) - fractU;
+            Lanes diffV = Lanes(float(y)) + lanesGather(l.y.data(), i) - fractV;
+            Lanes dist = lanesSqrt(diffU * diffU + diffV * diffV);
+            Lanes closer = lanesLess(dist, minDist1);
+            minDist2 = lanesSelect(closer, minDist1, lanesSelect(lanesLess(dist, minDist2), dist, minDist2));
+            minDist1 = lanesSelect(closer, dist, minDist1);
+        }
+    }
+}
+
+}
+
+ZoneFields TerrainGen::getZoneFields(glm::ivec2 zone) const {
+    // Rows of samples are evaluated a whole number of lane groups wide, as in getHeights
+    const int span = (ZONE_FIELD_SAMPLES + Lanes::WIDTH - 1) / Lanes::WIDTH * Lanes::WIDTH;
+    const glm::vec2 lo(zone), hi(zone + glm::ivec2(span - 1, ZONE_FIELD_SAMPLES - 1) * ZONE_FIELD_SPACING);
+    NoiseLattice mountainLattice = lattice(lo / 2400.f * 5.f, hi / 2400.f * 5.f, false);
+    NoiseLattice volcanoLattice = lattice(lo / 2600.f * 10.f, hi / 2600.f * 10.f, false);
+    NoiseLattice biomeLattice = lattice(lo / 4000.f * 10.f, hi / 4000.f * 10.f, true);
+
+    ZoneFields f;
+    f.min = zone;
+    f.mountainBase.resize(ZONE_FIELD_SAMPLES * ZONE_FIELD_SAMPLES);
+    f.volcanoDist.resize(ZONE_FIELD_SAMPLES * ZONE_FIELD_SAMPLES);
+    f.biomeBlend.resize(ZONE_FIELD_SAMPLES * ZONE_FIELD_SAMPLES);
+    for (int j = 0; j < ZONE_FIELD_SAMPLES; j++) {
+        for (int i0 = 0; i0 < ZONE_FIELD_SAMPLES; i0 += Lanes::WIDTH) {
+            Lanes colX = Lanes(float(zone.x)) + (Lanes(float(i0)) + lanesIota()) * Lanes(float(ZONE_FIELD_SPACING));
+            Lanes colZ(float(zone.y + j * ZONE_FIELD_SPACING));
+
+            // The first octave of getMountainH
+            Lanes minDist1(1.f), minDist2(1.f), unused(1.f), volcanoDist(1.f);
+            worleyLanes(mountainLattice, colX, colZ, 2400.f, 5.f, minDist1, minDist2);
+            Lanes mountain = lanesAbs((minDist2 - minDist1) * Lanes(2.f) - Lanes(1.f));
+            worleyLanes(volcanoLattice, colX, colZ, 2600.f, 10.f, volcanoDist, unused);
+            Lanes biome = (Lanes(5.f) * perlinLanes(biomeLattice, colX, colZ, 4000.f) + Lanes(1.f)) * Lanes(0.5f);
+
+            float m[Lanes::WIDTH], v[Lanes::WIDTH], b[Lanes::WIDTH];
+            lanesStore(m, mountain);
+            lanesStore(v, volcanoDist);
+            lanesStore(b, biome);
+            for (int i = 0; i < Lanes::WIDTH && i0 + i < ZONE_FIELD_SAMPLES; i++) {
+                int index = i0 + i + ZONE_FIELD_SAMPLES * j;
+                float h1 = pow(m[i], 1.2);
+                f.mountainBase[index] = h1 * 0.55f;
+                f.volcanoDist[index] = v[i];
+                f.biomeBlend[index] = b[i];
+            }
+        }
+    }
+    return f;
+}
+
+void TerrainGen::getHeights(glm::ivec2 minXZ, glm::ivec2 size, ColumnHeight* out, const ZoneFields *fields) const {
+    // Rows are evaluated a whole number of lane groups wide; columns past size.x are dropped
+    const int width = size.x;
+    const int span = (width + Lanes::WIDTH - 1) / Lanes::WIDTH * Lanes::WIDTH;
+    const glm::vec2 lo(minXZ), hi(minXZ + glm::ivec2(span - 1, size.y - 1));
+    if (fields != nullptr && (minXZ.x < fields->min.x || minXZ.y < fields->min.y
+                              || minXZ.x + span > fields->min.x + 64 || minXZ.y + size.y > fields->min.y + 64)) {
+        throw std::out_of_range("getHeights: columns outside the zone of the fields given");
+    }
+
+    // The octaves of getGrasslandsH and getMountainH. The fields stand in for
+    // the first mountain octave, the volcanoes and the biome blender.
+    float grassFreqs[4], grassAmps[4], mountainFreqs[4], mountainAmps[4];
+    NoiseLattice grassLattices[4], mountainLattices[4], volcanoLattice, biomeLattice;
+    float amp = 0.6;
+    float freq = 630;
+    for (int i = 0; i < 4; i++) {
+        grassFreqs[i] = freq;
+        grassAmps[i] = amp;
+        grassLattices[i] = lattice(lo / freq * 10.f, hi / freq * 10.f, true);
+        amp *= 0.6;
+        freq *= 0.7;
+    }
+    const int firstMountainOctave = fields != nullptr ? 1 : 0;
+    freq = 2400;
+    amp = 0.55;
+    for (int i = 0; i < 4; i++) {
+        mountainFreqs[i] = freq;
+        mountainAmps[i] = amp;
+        if (i >= firstMountainOctave) {
+            mountainLattices[i] = lattice(lo / freq * 5.f, hi / freq * 5.f, false);
+        }
+        amp *= 0.5;
+        freq *= 0.5;
+    }
+    if (fields == nullptr) {
+        volcanoLattice = lattice(lo / 2600.f * 10.f, hi / 2600.f * 10.f, false);
+        biomeLattice = lattice(lo / 4000.f * 10.f, hi / 4000.f * 10.f, true);
+    }
+
+    for (int z = 0; z < size.y; z++) {
+        for (int x0 = 0; x0 < width; x0 += Lanes::WIDTH) {
+            Lanes colX = Lanes(float(minXZ.x + x0)) + lanesIota();
+            Lanes colZ(float(minXZ.y + z));
+
+            Lanes grasslandsH(0.f);
+            for (int i = 0; i < 4; i++) {
+                Lanes perlin = (perlinLanes(grassLattices[i], colX, colZ, grassFreqs[i]) + Lanes(1.f)) / Lanes(2.f);
+                grasslandsH = grasslandsH + perlin * Lanes(grassAmps[i]);
+            }
+            grasslandsH = lanesFloor(Lanes(106.f) + grasslandsH * Lanes(60.f));
+
+            Lanes mountainsH(0.f), volcanoDist(1.f), biome(0.f);
+            if (fields != nullptr) {
+                // Bilinear between the four samples around each column
+                Lanes u = (colX - Lanes(float(fields->min.x))) / Lanes(float(ZONE_FIELD_SPACING));
+                Lanes v = (colZ - Lanes(float(fields->min.y))) / Lanes(float(ZONE_FIELD_SPACING));
+                Lanes cellU = lanesFloor(u), cellV = lanesFloor(v);
+                Lanes tU = u - cellU, tV = v - cellV;
+                Lanes i = cellU + Lanes(float(ZONE_FIELD_SAMPLES)) * cellV;
+                Lanes right = i + Lanes(1.f), up = i + Lanes(float(ZONE_FIELD_SAMPLES)), upRight = up + Lanes(1.f);
+                auto interpolate = [&](const std::vector<float> &field) {
+                    const float* f = field.data();
+                    Lanes low = lanesGather(f, i) + tU * (lanesGather(f, right) - lanesGather(f, i));
+                    Lanes high = lanesGather(f, up) + tU * (lanesGather(f, upRight) - lanesGather(f, up));
+                    return low + tV * (high - low);
+                };
+                mountainsH = interpolate(fields->mountainBase);
+                volcanoDist = interpolate(fields->volcanoDist);
+                biome = interpolate(fields->biomeBlend);
+            } else {
+                Lanes unused(1.f);
+                worleyLanes(volcanoLattice, colX, colZ, 2600.f, 10.f, volcanoDist, unused);
+                // The same arithmetic as BiomeBlender
+                biome = (Lanes(5.f) * perlinLanes(biomeLattice, colX, colZ, 4000.f) + Lanes(1.f)) * Lanes(0.5f);
+            }
+
+            for (int i = firstMountainOctave; i < 4; i++) {
+                Lanes minDist1(1.f), minDist2(1.f);
+                worleyLanes(mountainLattices[i], colX, colZ, mountainFreqs[i], 5.f, minDist1, minDist2);
+                Lanes h1 = lanesAbs((minDist2 - minDist1) * Lanes(2.f) - Lanes(1.f));
+                // No SIMD pow, and this one is only four calls a column
+                float h[Lanes::WIDTH];
+                lanesStore(h, h1);
+                for (float &f : h) {
+                    f = pow(f, 1.2);
+                }
+                mountainsH = mountainsH + lanesLoad(h) * Lanes(mountainAmps[i]);
+            }
+            mountainsH = lanesFloor(Lanes(135.f) + mountainsH * Lanes(110.f));
+
+            Lanes volcanoH = lanesFloor(Lanes(50.f) + (Lanes(1.f) - volcanoDist) * Lanes(206.f));
+
+            float g[Lanes::WIDTH], m[Lanes::WIDTH], v[Lanes::WIDTH], vDist[Lanes::WIDTH], b[Lanes::WIDTH];
+            lanesStore(g, grasslandsH);
+            lanesStore(m, mountainsH);
+            lanesStore(v, volcanoH);
+            lanesStore(vDist, volcanoDist);
+            lanesStore(b, biome);
+            for (int i = 0; i < Lanes::WIDTH && x0 + i < width; i++) {
+                // The same arithmetic as WorleyNoise2's hole test
+                out[x0 + i + width * z] = blendHeights(g[i], m[i], {v[i], vDist[i] < 0.15}, b[i]);
+            }
+        }
+    }
+}
+
+float TerrainGen::getSeed() const {
+    return seed;
+}
+
+NoiseHash TerrainGen::getHash() const {
+    return hash;
 }
 
-void TerrainGen::setSeed(float seed) {
-    TerrainGen::seed = seed;
+int TerrainGen::getCaveSpacing() const {
+    return caveSpacing;
 }
@@ -3,8 +3,10 @@
 
 #include "la.h"
 #include <cmath>
+#include <cstdint>
 #include <random>
 #include <stack>
+#include <vector>
 
 enum BiomeType {
     GRASSLANDS,
@@ -12,35 +14,103 @@ enum BiomeType {
     VOLCANO
 };
 
+// How TerrainGen hashes lattice points. TRIG_HASH is the original
+// fract(cos(...)) hash, whose results depend on how the platform computes cos;
+// INTEGER_HASH is a PCG hash of the point's coordinates and the seed, which
+// gives the same lattice everywhere. Each world records its hash in its .save.
+enum NoiseHash {
+    TRIG_HASH,
+    INTEGER_HASH
+};
+
+// Written to a .save after the seed, followed by the world's NoiseHash as an int.
+// It reads as the key of a Chunk no world reaches, so saves without it load as
+// TRIG_HASH worlds with their Chunk keys following the seed.
+#define SAVE_NOISE_HASH_TAG INT64_MIN
+
+// Cave noise is sampled every CAVE_SAMPLE_SPACING blocks along each axis and
+// interpolated in between. It must divide 16; 1 samples every block exactly.
+#define CAVE_SAMPLE_SPACING 4
+
+// Spacing in blocks of the samples of a zone's ZoneFields. Must divide 64.
+#define ZONE_FIELD_SPACING 4
+// Samples along each side of a zone, reaching the far edge it shares with the next zone
+#define ZONE_FIELD_SAMPLES (64 / ZONE_FIELD_SPACING + 1)
+
+// The terms of getHeight that barely change across a 64 x 64 zone: the first
+// mountain octave, the volcano distance and the biome blender. Sampled every
+// ZONE_FIELD_SPACING blocks from the zone's lower corner min, sample (i, j)
+// at index i + ZONE_FIELD_SAMPLES * j. Neighbouring zones sample their shared
+// edge at the same points, so interpolating them leaves no seams.
+struct ZoneFields {
+    glm::ivec2 min;
+    std::vector<float> mountainBase, volcanoDist, biomeBlend;
+};
+
+// One column of terrain, as returned by TerrainGen::getHeight
+struct ColumnHeight {
+    int height;
+    BiomeType biome;
+    bool vFlip;
+};
+
+// The random2 values of a block of lattice points, shared by the columns of a batch
+struct NoiseLattice;
+
+// Generates the terrain of one world. Its seed, hash and tuning are fixed when it is
+// made and every method is const, so the threads generating Chunks share one freely,
+// and Terrains of different worlds can generate side by side.
 class TerrainGen {
 private:
-    static glm::vec2 random2(glm::vec2 p);
-    static float noise2D(glm::vec2 p);
-    static float interpNoise2D(glm::vec2 xy);
-    static float fbm(glm::vec2 xy);
+    float noise2D(glm::vec2 p) const;
+    float interpNoise2D(glm::vec2 xy) const;
+    float fbm(glm::vec2 xy) const;
 
-    static float WorleyNoise(glm::vec2 uv);
-    static std::pair<float, bool> WorleyNoise2 (glm::vec2 uv);
+    float WorleyNoise(glm::vec2 uv) const;
+    std::pair<float, bool> WorleyNoise2 (glm::vec2 uv) const;
 
-    static float surflet(glm::vec2 P, glm::vec2 gridPoint);
-    static float PerlinNoise(glm::vec2 uv);
+    float surflet(glm::vec2 P, glm::vec2 gridPoint) const;
+    float PerlinNoise(glm::vec2 uv) const;
 
-    static glm::vec3 random3(glm::vec3 xyz);
-    static float surflet3D(glm::vec3 p, glm::vec3 gridPoint);
+    float surflet3D(glm::vec3 p, glm::vec3 gridPoint) const;
 
-    static float getMountainH(glm::vec2 xz);
-    static float getGrasslandsH(glm::vec2 xz);
-    static std::pair<float, bool> getVolcanoH(glm::vec2 xz);
+    float getMountainH(glm::vec2 xz) const;
+    float getGrasslandsH(glm::vec2 xz) const;
+    std::pair<float, bool> getVolcanoH(glm::vec2 xz) const;
 
-    static float BiomeBlender(glm::vec2 xz);
+    float BiomeBlender(glm::vec2 xz) const;
+    static ColumnHeight blendHeights(float grasslandsH, float mountainsH,
+                                     std::pair<float, bool> volcano, float biomeBlend);
+    NoiseLattice lattice(glm::vec2 uvMin, glm::vec2 uvMax, bool gradient) const;
 
-    static float seed;
+    float seed;
+    NoiseHash hash;
+    // Cave noise is sampled every caveSpacing blocks along each axis
+    int caveSpacing;
 public:
-    TerrainGen();
-    static std::tuple<int, BiomeType, bool> getHeight(glm::vec2 xz);
-    static float perlinNoise3D(glm::vec3 p);
-    static float WorleyNoise3(float x, float y);
-    static void setSeed(float seed);
+    // Throws std::invalid_argument unless caveSpacing is at least 1 and divides 16
+    TerrainGen(float seed = 0.f, NoiseHash hash = TRIG_HASH, int caveSpacing = CAVE_SAMPLE_SPACING);
+    // The hash of a lattice point, each component in [0, 1)
+    glm::vec2 random2(glm::vec2 p) const;
+    glm::vec3 random3(glm::vec3 xyz) const;
+    std::tuple<int, BiomeType, bool> getHeight(glm::vec2 xz) const;
+    // Evaluates getHeight for the size.x x size.y columns whose lowest corner is minXZ
+    // (16 x 16 for a Chunk, 64 x 64 for a zone), writing column (x, z) to out[x + size.x * z].
+    // Columns share the hash of every lattice point they have in common, and each row
+    // is evaluated several columns at a time in SIMD lanes. The Perlin falloff uses
+    // products where getHeight uses pow, so a column sitting on a block boundary can
+    // come out 1 block off, or a biome boundary column in the other biome; see
+    // benchmarkHeights for how often that happens.
+    // Given the fields of the zone holding every column, interpolates them in place
+    // of their terms, which moves some heights by a few blocks; see benchmarkZoneFields.
+    void getHeights(glm::ivec2 minXZ, glm::ivec2 size, ColumnHeight* out, const ZoneFields *fields = nullptr) const;
+    // Samples the fields of the zone with the given lower corner
+    ZoneFields getZoneFields(glm::ivec2 zone) const;
+    float perlinNoise3D(glm::vec3 p) const;
+    float WorleyNoise3(float x, float y) const;
+    float getSeed() const;
+    NoiseHash getHash() const;
+    int getCaveSpacing() const;
 };
 
 #endif // TERRAINGEN_H
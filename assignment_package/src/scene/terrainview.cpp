@@ -0,0 +1,53 @@
+#include "terrainview.h"
+
+TerrainView::TerrainView(const Terrain &terrain, glm::ivec3 pos)
+    : mcr_terrain(terrain), m_pos(pos), m_chunkCoords(pos.x >> 4, pos.z >> 4), m_chunks()
+{
+    cacheChunks();
+}
+
+void TerrainView::cacheChunks() {
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            m_chunks[(dx + 1) + 3 * (dz + 1)] = mcr_terrain.findGeneratedChunk(16 * (m_chunkCoords.x + dx),
+                                                                               16 * (m_chunkCoords.y + dz));
+        }
+    }
+}
+
+void TerrainView::moveTo(glm::ivec3 pos) {
+    m_pos = pos;
+    glm::ivec2 chunkCoords(pos.x >> 4, pos.z >> 4);
+    if (chunkCoords != m_chunkCoords) {
+        m_chunkCoords = chunkCoords;
+        cacheChunks();
+    }
+}
+
+void TerrainView::step(int dx, int dy, int dz) {
+    moveTo(m_pos + glm::ivec3(dx, dy, dz));
+}
+
+glm::ivec3 TerrainView::getPosition() const {
+    return m_pos;
+}
+
+void TerrainView::read(glm::ivec3 offset, glm::ivec3 size, BlockType* out) const {
+    glm::ivec3 min = m_pos + offset;
+    for (int z = 0; z < size.z; z++) {
+        for (int x = 0; x < size.x; x++) {
+            const Chunk* c = chunkAt(min.x + x, min.z + z);
+            unsigned int localX = static_cast<unsigned int>((min.x + x) & 15);
+            unsigned int localZ = static_cast<unsigned int>((min.z + z) & 15);
+            for (int y = 0; y < size.y; y++) {
+                int worldY = min.y + y;
+                BlockType t = UNLOADED_BLOCK;
+                if (c != nullptr) {
+                    t = (worldY < 0 || worldY >= 256) ? EMPTY
+                                                      : c->getBlockAt(localX, static_cast<unsigned int>(worldY), localZ);
+                }
+                out[x + size.x * (y + size.y * z)] = t;
+            }
+        }
+    }
+}
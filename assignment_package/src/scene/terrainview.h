@@ -0,0 +1,77 @@
+#pragma once
+#include "terrain.h"
+
+// What TerrainView reads for blocks whose Chunk is not loaded. It is not a
+// real block type, so check for it before calling blockProperties.
+#define UNLOADED_BLOCK static_cast<BlockType>(BLOCK_TYPE_COUNT)
+
+// A cursor over the blocks of a Terrain, for code that reads many blocks
+// close together: physics, raycasts, tree building and mob AI.
+// It remembers the Chunk it is in and the eight around it, so reads near
+// the cursor skip resolving their Chunk, and it never throws: blocks of
+// Chunks that are unloaded or not generated yet read as UNLOADED_BLOCK, and
+// blocks above or below the world as EMPTY, as Terrain::getBlockAt does.
+// Only valid while no Chunk is loaded or unloaded, i.e. within one frame,
+// and only on the main thread, since it reads blocks without locking.
+class TerrainView {
+private:
+    const Terrain &mcr_terrain;
+    // World-space block the cursor is on
+    glm::ivec3 m_pos;
+    // Chunk coordinates (world-space / 16) of the Chunk the cursor is in
+    glm::ivec2 m_chunkCoords;
+    // The 3 x 3 Chunks centred on the cursor's, indexed (dx + 1) + 3 * (dz + 1).
+    // Null where no Chunk is loaded or its blocks are not generated yet.
+    std::array<const Chunk*, 9> m_chunks;
+
+    // Refills m_chunks after the cursor moved into another Chunk
+    void cacheChunks();
+
+public:
+    TerrainView(const Terrain &terrain, glm::ivec3 pos);
+
+    // Moves the cursor to a world-space block
+    void moveTo(glm::ivec3 pos);
+    // Moves the cursor by the given number of blocks along each axis
+    void step(int dx, int dy, int dz);
+    glm::ivec3 getPosition() const;
+
+    // The Chunk containing world-space (x, z), or null if it is not loaded or generated
+    const Chunk* chunkAt(int x, int z) const {
+        int dx = (x >> 4) - m_chunkCoords.x, dz = (z >> 4) - m_chunkCoords.y;
+        if (dx >= -1 && dx <= 1 && dz >= -1 && dz <= 1) {
+            return m_chunks[(dx + 1) + 3 * (dz + 1)];
+        }
+        return mcr_terrain.findGeneratedChunk(x, z);
+    }
+    // The Chunk the cursor is in, or null if it is not loaded
+    const Chunk* getChunk() const {
+        return m_chunks[4];
+    }
+
+    // The block at world-space (x, y, z)
+    BlockType blockAt(int x, int y, int z) const {
+        const Chunk* c = chunkAt(x, z);
+        if (c == nullptr) {
+            return UNLOADED_BLOCK;
+        }
+        if (y < 0 || y >= 256) {
+            return EMPTY;
+        }
+        return c->getBlockAt(static_cast<unsigned int>(x & 15), static_cast<unsigned int>(y),
+                             static_cast<unsigned int>(z & 15));
+    }
+    // The block under the cursor
+    BlockType get() const {
+        return blockAt(m_pos.x, m_pos.y, m_pos.z);
+    }
+    // The block at the given offset from the cursor
+    BlockType get(int dx, int dy, int dz) const {
+        return blockAt(m_pos.x + dx, m_pos.y + dy, m_pos.z + dz);
+    }
+
+    // Reads the box of blocks of the given size whose lowest corner is at the
+    // given offset from the cursor into out, indexed x + size.x * (y + size.y * z).
+    // Each column of the box resolves its Chunk once.
+    void read(glm::ivec3 offset, glm::ivec3 size, BlockType* out) const;
+};
@@ -0,0 +1,57 @@
+#include "zonefieldcache.h"
+#include "terrain.h"
+#include <algorithm>
+#include <chrono>
+
+ZoneFieldCache::ZoneFieldCache()
+    : m_mutex(), m_zones(), m_order(), m_hits(0), m_misses(0), m_sampleNanos(0)
+{}
+
+sPtr<const ZoneFields> ZoneFieldCache::get(const TerrainGen &gen, glm::ivec2 zone) {
+    int64_t key = toKey(zone.x, zone.y);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_zones.find(key);
+        if (it != m_zones.end()) {
+            m_hits++;
+            return it->second;
+        }
+    }
+    m_misses++;
+    // Sampled without the lock so other zones' Chunks are not held up. Two threads
+    // missing the same zone both sample it, and the first one's fields are kept.
+    auto start = std::chrono::steady_clock::now();
+    sPtr<const ZoneFields> fields = mkS<const ZoneFields>(gen.getZoneFields(zone));
+    auto end = std::chrono::steady_clock::now();
+    m_sampleNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto inserted = m_zones.insert({key, fields});
+    if (inserted.second) {
+        m_order.push_back(key);
+        if (m_order.size() > ZONE_FIELD_CACHE_SIZE) {
+            m_zones.erase(m_order.front());
+            m_order.pop_front();
+        }
+    }
+    return inserted.first->second;
+}
+
+void ZoneFieldCache::erase(glm::ivec2 zone) {
+    int64_t key = toKey(zone.x, zone.y);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_zones.erase(key) > 0) {
+        m_order.erase(std::find(m_order.begin(), m_order.end(), key));
+    }
+}
+
+size_t ZoneFieldCache::getHits() const {
+    return m_hits;
+}
+
+size_t ZoneFieldCache::getMisses() const {
+    return m_misses;
+}
+
+double ZoneFieldCache::getSampleMillis() const {
+    return m_sampleNanos / 1e6;
+}
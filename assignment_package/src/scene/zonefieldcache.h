@@ -0,0 +1,40 @@
+#pragma once
+#include "terraingen.h"
+#include "smartpointerhelp.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+// Number of zones whose fields a ZoneFieldCache keeps. The Chunks of a zone
+// are generated together, so it only has to cover the zones being generated
+// at once: at most the 5 x 5 zones within CREATE_RADIUS, with room to spare.
+#define ZONE_FIELD_CACHE_SIZE 64
+
+// The ZoneFields of the zones being generated, so that the threads generating
+// the 16 Chunks of a zone sample its fields once between them. Safe to use
+// from any thread.
+class ZoneFieldCache {
+private:
+    mutable std::mutex m_mutex;
+    std::unordered_map<int64_t, sPtr<const ZoneFields>> m_zones;
+    // Keys of the cached zones, oldest first
+    std::deque<int64_t> m_order;
+    std::atomic<size_t> m_hits, m_misses;
+    // Time spent sampling the fields of missed zones
+    std::atomic<int64_t> m_sampleNanos;
+
+public:
+    ZoneFieldCache();
+
+    // The fields of the zone with the given lower corner, sampled with gen if
+    // they are not cached. They stay valid after the zone leaves the cache.
+    sPtr<const ZoneFields> get(const TerrainGen &gen, glm::ivec2 zone);
+    // Drops the zone's fields, once its Chunks no longer need generating
+    void erase(glm::ivec2 zone);
+
+    size_t getHits() const;
+    size_t getMisses() const;
+    // Milliseconds spent sampling fields, summed over every miss and thread
+    double getSampleMillis() const;
+};
@@ -8,9 +8,9 @@
 
 ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
-    attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1), attrAnimated(-1), attrIds(-1), attrWeights(-1),
+    attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1), attrAnimated(-1), attrPacked(-1), attrIds(-1), attrWeights(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1),
-      unifTime(-1), unifSampler2D(-1), unifBinds(-1), unifTransforms(-1), context(context)
+      unifTime(-1), unifChunkOrigin(-1), unifSampler2D(-1), unifBinds(-1), unifTransforms(-1), context(context)
 {}
 
 void ShaderProgram::create(const char *vertfile, const char *fragfile)
@@ -67,6 +67,7 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     attrPosOffset = context->glGetAttribLocation(prog, "vs_OffsetInstanced");
     attrUV = context->glGetAttribLocation(prog, "vs_UV");
     attrAnimated = context->glGetAttribLocation(prog, "vs_Animated");
+    attrPacked = context->glGetAttribLocation(prog, "vs_Packed");
     attrIds = context->glGetAttribLocation(prog, "vs_Ids");
     attrWeights = context->glGetAttribLocation(prog, "vs_Weights");
 
@@ -75,6 +76,7 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unifViewProj   = context->glGetUniformLocation(prog, "u_ViewProj");
     unifColor      = context->glGetUniformLocation(prog, "u_Color");
     unifTime = context->glGetUniformLocation(prog, "u_Time");
+    unifChunkOrigin = context->glGetUniformLocation(prog, "u_ChunkOrigin");
     unifSampler2D = context->glGetUniformLocation(prog, "u_Texture");
 
     unifBinds      = context->glGetUniformLocation(prog, "u_Binds");
@@ -160,6 +162,14 @@ void ShaderProgram::setTexture(int textureSlot = 0) {
     }
 }
 
+void ShaderProgram::setChunkOrigin(glm::ivec2 origin) {
+    useMe();
+
+    if (unifChunkOrigin != -1) {
+        context->glUniform2i(unifChunkOrigin, origin.x, origin.y);
+    }
+}
+
 void ShaderProgram::setBinds(std::array<glm::mat4, 100>& arr, int mCount) {
     useMe();
 
@@ -246,49 +256,18 @@ void ShaderProgram::drawInterleaved(Drawable &d)
     // and if the VBO contains this attribute
     // If so, bind buffer to the attribute
 
-    // if no color will be 3
-    static const unsigned int sizeOfInterleaved = 3;
-    //    unsigned int sizeOfInterleaved = (attrCol != -1) ? 4 : 3;
-
-    if (attrPos != -1 && d.bindInterleaved())
+    // Every vertex is two unsigned ints that the vertex shader unpacks
+    if (attrPacked != -1 && d.bindInterleaved())
     {
-        context->glEnableVertexAttribArray(attrPos);
-        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, sizeOfInterleaved * sizeof(glm::vec4), (void*)0);
-    }
-
-    if (attrNor != -1 && d.bindInterleaved())
-    {
-        context->glEnableVertexAttribArray(attrNor);
-        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, sizeOfInterleaved * sizeof(glm::vec4), (void*)(1 * sizeof(glm::vec4)));
-    }
-
-    //    if (attrCol != -1 && d.bindInterleaved())
-    //    {
-    //        context->glEnableVertexAttribArray(attrCol);
-    //        context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, sizeOfInterleaved * sizeof(glm::vec4), (void*)(3 * sizeof(glm::vec4)));
-    //    }
-
-    if (attrUV != -1 && d.bindInterleaved())
-    {
-        context->glEnableVertexAttribArray(attrUV);
-        context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, sizeOfInterleaved * sizeof(glm::vec4), (void*)(2 * sizeof(glm::vec4)));
-    }
-
-    if (attrAnimated != -1 && d.bindInterleaved())
-    {
-        context->glEnableVertexAttribArray(attrAnimated);
-        context->glVertexAttribPointer(attrAnimated, 1, GL_FLOAT, false, sizeOfInterleaved * sizeof(glm::vec4), (void*)(2 * sizeof(glm::vec4) + sizeof(glm::vec2)));
+        context->glEnableVertexAttribArray(attrPacked);
+        context->glVertexAttribIPointer(attrPacked, 2, GL_UNSIGNED_INT, sizeof(glm::uvec2), nullptr);
     }
 
     // Bind the index buffer and draw shapes
     d.bindIdx();
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
-    if (attrAnimated != -1) context->glDisableVertexAttribArray(attrAnimated);
+    if (attrPacked != -1) context->glDisableVertexAttribArray(attrPacked);
 
     context->printGLErrorLog();
 }
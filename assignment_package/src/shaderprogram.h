@@ -21,6 +21,7 @@ public:
     int attrPosOffset; // A handle for a vec3 used only in the instanced rendering shader
     int attrUV;
     int attrAnimated;
+    int attrPacked; // A handle for the "in" uvec2 holding a packed chunk vertex (see ChunkVertex)
     int attrIds; //new handle for hw7 for ids of joints that influence the vertex
     int attrWeights; //new handle for hw7 for weights of joints that influence that vertex
 
@@ -29,6 +30,7 @@ public:
     int unifViewProj; // A handle for the "uniform" mat4 representing combined projection and view matrices in the vertex shader
     int unifColor; // A handle for the "uniform" vec4 representing color of geometry in the vertex shader
     int unifTime;
+    int unifChunkOrigin; // A handle for the "uniform" ivec2 holding the world-space x and z of the chunk being drawn
     int unifSampler2D;
     int unifBinds; //new handle for hw7 that is a handle for the bind matrices
     int unifTransforms; //new handle for hw7 that is a handle for the transformation matrices
@@ -49,6 +51,8 @@ public:
     void setTime(float t);
     // set texture
     void setTexture(int textureSlot);
+    // Pass the minimum x and z corner of the chunk about to be drawn
+    void setChunkOrigin(glm::ivec2 origin);
     // Draw the given object to our screen using this ShaderProgram's shaders
 
     void setBinds(std::array<glm::mat4, 100>& arr, int mCount);
@@ -64,7 +68,7 @@ public:
     // Utility function that prints any shader linking errors to the console
     void printLinkInfoLog(int prog);
 
-    // Draw the given objects to our screen using the interleaved VBO
+    // Draw the given objects to our screen using the interleaved VBO of packed chunk vertices
     void drawInterleaved(Drawable &d);
 
     void draw(EntityDrawable &d);
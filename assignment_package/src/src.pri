@@ -2,6 +2,7 @@ INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
 SOURCES += \
+    $$PWD/benchmark.cpp \
     $$PWD/framebuffer.cpp \
     $$PWD/inventory.cpp \
     $$PWD/la.cpp \
@@ -18,12 +19,18 @@ SOURCES += \
     $$PWD/scene/cube.cpp \
     $$PWD/openglcontext.cpp \
     $$PWD/scene/terrain.cpp \
+    $$PWD/scene/terrainview.cpp \
+    $$PWD/scene/jobsystem.cpp \
+    $$PWD/scene/meshbufferpool.cpp \
     $$PWD/scene/worldaxes.cpp \
     $$PWD/scene/entity.cpp \
     $$PWD/scene/player.cpp \
     $$PWD/scene/camera.cpp \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
+    $$PWD/scene/chunkgrid.cpp \
+    $$PWD/scene/zonefieldcache.cpp \
+    $$PWD/scene/generationpipeline.cpp \
     $$PWD/tree.cpp \
     $$PWD/wolf/component.cpp \
     $$PWD/wolf/cow.cpp \
@@ -33,6 +40,7 @@ SOURCES += \
     $$PWD/startwindow.cpp \
 
 HEADERS += \
+    $$PWD/benchmark.h \
     $$PWD/framebuffer.h \
     $$PWD/inventory.h \
     $$PWD/la.h \
@@ -48,6 +56,10 @@ HEADERS += \
     $$PWD/scene/cube.h \
     $$PWD/openglcontext.h \
     $$PWD/scene/terrain.h \
+    $$PWD/scene/terrainview.h \
+    $$PWD/scene/jobsystem.h \
+    $$PWD/scene/mpscqueue.h \
+    $$PWD/scene/meshbufferpool.h \
     $$PWD/scene/worldaxes.h \
     $$PWD/smartpointerhelp.h \
     $$PWD/glm_includes.h \
@@ -56,6 +68,10 @@ HEADERS += \
     $$PWD/scene/camera.h \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
+    $$PWD/scene/chunkgrid.h \
+    $$PWD/scene/zonefieldcache.h \
+    $$PWD/scene/generationpipeline.h \
+    $$PWD/scene/blockregistry.h \
     $$PWD/tree.h \
     $$PWD/wolf/component.h \
     $$PWD/wolf/cow.h \
@@ -1,5 +1,6 @@
 #include "startwindow.h"
 #include "ui_startwindow.h"
+#include "scene/terraingen.h"
 #include <QMessageBox>
 
 StartWindow::StartWindow(QWidget *parent, MainWindow* game) :
@@ -38,6 +39,7 @@ void StartWindow::start_load_game() {
 void StartWindow::start_new_game() {
     QString name = ui->newGameName->text();
     int seed = ui->newGameSeed->value();
+    NoiseHash hash = ui->newGameIntegerHash->isChecked() ? INTEGER_HASH : TRIG_HASH;
 
     QDir directory("../saves");
     if (!directory.mkdir(name)) {
@@ -49,8 +51,10 @@ void StartWindow::start_new_game() {
     file.open(QIODevice::WriteOnly);
     QDataStream out(&file);
 
-    // player x (float), player y (float), player z (float), seed (int)
+    // player x (float), player y (float), player z (float), seed (int),
+    // noise hash tag (int64), noise hash (int)
     out << (float)48.f << (float)170.f << (float)48.f << (int)seed;
+    out << (int64_t)SAVE_NOISE_HASH_TAG << (int)hash;
 
     file.close();
 
@@ -312,14 +312,14 @@ bool gridMarchW(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terr
         // Sets it to 0 if sign is +, -1 if sign is -
         offset[interfaceAxis] = glm::min(0.f, glm::sign(rayDirection[interfaceAxis]));
         currCell = glm::ivec3(glm::floor(rayOrigin)) + offset;
-        // If currCell contains something other than EMPTY, return
+        // If currCell contains a solid block, return
         // curr_t
         if (!terrain.hasChunkAt(currCell.x, currCell.z)) {
             *out_dist = glm::min(maxLen, curr_t);
             return false;
         }
         BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-        if(cellType != EMPTY && cellType != WATER && cellType != LAVA) {
+        if(blockProperties(cellType).solid) {
             *out_blockHit = currCell;
             *out_dist = glm::min(maxLen, curr_t);
             return true;
@@ -494,6 +494,12 @@ void Cow::updatePlayerPos(glm::vec3 newPos) {
 
 void Cow::summon() {
     this->m_position = this->playerPos - glm::vec3(0, -2, 10);
+    // Stand on top of the column, the bounding box reaching 0.6 below m_position,
+    // rather than inside a hill or up in the air
+    int ground = terrain.getHeightAt(TOP_NON_AIR, glm::floor(m_position.x), glm::floor(m_position.z));
+    if (ground != -1) {
+        this->m_position.y = ground + 1.6f;
+    }
 }
 
 glm::vec3 Cow::getMPos() const {